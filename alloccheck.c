@@ -0,0 +1,84 @@
+// make check: walks the per-move path (parsing and printing moves, legality, making moves,
+// generation, game status) over a few positions with malloc, calloc and realloc wrapped by
+// the linker (-Wl,--wrap=...), and fails if any of them is called while counting
+#include "tchess.h"
+#include "generators.h"
+#include "bitboard.h"
+#include "rules.h"
+#include "eval.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+	if (counting) allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	if (counting) allocations++;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	if (counting) allocations++;
+	return __real_realloc(ptr, size);
+}
+
+static const char *positions[] = {
+	START_FEN,
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"7k/6Q1/6K1/8/8/8/8/8 b - - 0 1",
+};
+
+// Every move of pos, two plies deep, through the same calls as a move typed by a player
+static unsigned long walk(const Position *pos, int depth) {
+	unsigned long moves = 0;
+	MoveList ml;
+	generate_legal(pos, &ml);
+	for (int i = 0; i < ml.count; i++) {
+		char uci[6], from[3], fen[FEN_MAX];
+		move_to_uci(ml.list[i], uci);
+		square_name(move_from(ml.list[i]), from);
+		Move m = uci_to_move(pos, uci);
+		if (m == MOVE_NONE || !is_pseudo_legal(pos, m) || !is_legal(pos, m)) continue;
+		Position next = *pos;
+		make_move(&next, m);
+		status(&next, next.side_to_move, 1);
+		count_legal(&next);
+		has_any_legal_move(&next);
+		is_in_check(&next, next.side_to_move);
+		position_to_fen(&next, fen);
+		parse_fen(fen, &next);
+		moves++;
+		if (depth > 1) moves += walk(&next, depth - 1);
+	}
+	return moves;
+}
+
+int main(void) {
+	init_bitboards();
+	init_zobrist();
+	init_eval();
+
+	unsigned long moves = 0;
+	counting = true;
+	for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+		Position pos;
+		if (parse_fen(positions[i], &pos)) moves += walk(&pos, 2);
+	}
+	counting = false;
+
+	printf("%lu moves, %lu heap allocations\n", moves, allocations);
+	return allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+#include "batch.h"
+#include "tchess.h"
+#include "chunks.h"
+#include "generators.h"
+#include "rules.h"
+#include "threadpool.h"
+#include "timeman.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_MAX_CHARS 256     // longer lines are cut: the FEN fields come first anyway
+
+enum { POSITIONS, INVALID }; // chunk counters
+
+// Examine one line (without its newline) and append the result
+static void examine(Chunk *c, const char *line, size_t length) {
+	// parse_fen wants a terminated string; the copy also keeps it from reading the next line
+	char fen[LINE_MAX_CHARS];
+	if (length >= sizeof(fen)) length = sizeof(fen) - 1;
+	memcpy(fen, line, length);
+	fen[length] = '\0';
+
+	char result[64];
+	int n;
+	Position pos;
+	c->counts[POSITIONS]++;
+	if (parse_fen(fen, &pos)) {
+		Color us = pos.side_to_move;
+		n = snprintf(result, sizeof(result), "%d %d %s\n", count_legal(&pos), is_in_check(&pos, us) ? 1 : 0,
+		             status_name(status(&pos, us, 1)));
+	} else {
+		c->counts[INVALID]++;
+		n = snprintf(result, sizeof(result), "invalid\n");
+	}
+	chunk_append(c, result, (size_t)n);
+}
+
+static void examine_lines(Chunk *c) {
+	const char *p = c->begin;
+	while (p < c->end) {
+		const char *eol = memchr(p, '\n', (size_t)(c->end - p));
+		if (!eol) eol = c->end;
+		size_t length = (size_t)(eol - p);
+		if (length > 0 && p[length - 1] == '\r') length--;
+		examine(c, p, length);
+		p = eol + 1;
+	}
+}
+
+// Cut after the first newline at or past p
+static const char *next_line(const char *p, const char *end) {
+	const char *eol = memchr(p, '\n', (size_t)(end - p));
+	return eol ? eol + 1 : end;
+}
+
+int batch_command(int argc, char **argv) {
+	int threads = pool_default_threads();
+
+	// Options first: -t <threads>
+	while (argc >= 2 && argv[0][0] == '-') {
+		if (strcmp(argv[0], "-t") == 0) threads = atoi(argv[1]);
+		else break;
+		argc -= 2;
+		argv += 2;
+	}
+	if (threads < 1) threads = 1;
+	if (argc < 1) {
+		fprintf(stderr, "Usage: tchess batch [-t threads] <file>\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t totals[CHUNK_COUNTERS] = { 0 };
+	double start = tm_now();
+	int result = chunks_run_file(argv[0], threads, next_line, examine_lines, totals);
+	if (result != EXIT_SUCCESS) return result;
+	double elapsed = tm_now() - start;
+	fprintf(stderr, "%zu positions (%zu invalid) in %.3f s, %.0f positions/s\n", totals[POSITIONS], totals[INVALID],
+	        elapsed, elapsed > 0 ? totals[POSITIONS] / elapsed : 0.0);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Command line entry point: tchess batch [-t threads] <file>
+// Reads a file of FEN or EPD positions, one per line, and prints one line per input line, in
+// the same order: "<legal moves> <1 if in check, else 0> <status>", or "invalid".
+int batch_command(int argc, char **argv);
+
+#endif // BATCH_H
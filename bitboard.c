@@ -0,0 +1,131 @@
+#include "bitboard.h"
+#include "directions.h"
+
+Bitboard knight_attacks[NUM_SQUARES];
+Bitboard king_attacks[NUM_SQUARES];
+Bitboard pawn_attacks[2][NUM_SQUARES];
+Bitboard between_bb[NUM_SQUARES][NUM_SQUARES];
+Bitboard line_bb[NUM_SQUARES][NUM_SQUARES];
+
+Magic bishop_magics[NUM_SQUARES];
+Magic rook_magics[NUM_SQUARES];
+static Bitboard bishop_table[0x1480]; // sum over squares of 2^(mask bits)
+static Bitboard rook_table[0x19000];
+
+// Squares reached from sq by the given (file, rank) steps, one step each
+static Bitboard leaper_attacks(Square sq, const int steps[][2], int num_steps) {
+	Bitboard attacks = 0;
+	for (int i = 0; i < num_steps; i++) {
+		int f = file_of(sq) + steps[i][0];
+		int r = rank_of(sq) + steps[i][1];
+		if (in_board(f, r)) attacks |= sq_bb(SQ(f, r));
+	}
+	return attacks;
+}
+
+// Walk each ray until the edge of the board or the first occupied square (included)
+static Bitboard ray_attacks(Square sq, Bitboard occupied, const int directions[][2], int num_dirs) {
+	Bitboard attacks = 0;
+	for (int i = 0; i < num_dirs; i++) {
+		int f = file_of(sq) + directions[i][0];
+		int r = rank_of(sq) + directions[i][1];
+		while (in_board(f, r)) {
+			Bitboard b = sq_bb(SQ(f, r));
+			attacks |= b;
+			if (occupied & b) break;
+			f += directions[i][0];
+			r += directions[i][1];
+		}
+	}
+	return attacks;
+}
+
+// Magic multipliers: each maps every relevant occupancy of its square to a slot of the
+// table without destructive collisions (found offline by trial of sparse random numbers)
+static const Bitboard bishop_magic_numbers[NUM_SQUARES] = {
+	0x40106000a1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL, 0x002806004050c040ULL,
+	0x0002021018000000ULL, 0x2001112010000400ULL, 0x0881010120218080ULL, 0x1030820110010500ULL,
+	0x0000120222042400ULL, 0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422a02000001ULL,
+	0x000a220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL, 0x0100004042101040ULL,
+	0x0004001004082820ULL, 0x0010000810010048ULL, 0x1014004208081300ULL, 0x2080818802044202ULL,
+	0x0040880c00a00100ULL, 0x0080400200522010ULL, 0x0001000188180b04ULL, 0x0080249202020204ULL,
+	0x1004400004100410ULL, 0x00013100a0022206ULL, 0x2148500001040080ULL, 0x4241080011004300ULL,
+	0x4020848004002000ULL, 0x10101380d1004100ULL, 0x0008004422020284ULL, 0x01010a1041008080ULL,
+	0x0808080400082121ULL, 0x0808080400082121ULL, 0x0091128200100c00ULL, 0x0202200802010104ULL,
+	0x8c0a020200440085ULL, 0x01a0008080b10040ULL, 0x0889520080122800ULL, 0x100902022202010aULL,
+	0x04081a0816002000ULL, 0x0000681208005000ULL, 0x8170840041008802ULL, 0x0a00004200810805ULL,
+	0x0830404408210100ULL, 0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+	0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440a210428ULL, 0x0008240020880021ULL,
+	0x0400002012048200ULL, 0x00ac102001210220ULL, 0x0220021002009900ULL, 0x84440c080a013080ULL,
+	0x0001008044200440ULL, 0x0004c04410841000ULL, 0x2000500104011130ULL, 0x1a0c010011c20229ULL,
+	0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822c08200ULL, 0x48081010008a2a80ULL,
+};
+static const Bitboard rook_magic_numbers[NUM_SQUARES] = {
+	0x0880004000108025ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+	0xc200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+	0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+	0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+	0x0040048001458024ULL, 0x00a0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+	0x5004808008000401ULL, 0x2024818004000a00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+	0x0080400880008421ULL, 0x4062220600410280ULL, 0x010a004a00108022ULL, 0x0000100080080080ULL,
+	0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xc020128200040545ULL,
+	0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010a386103001001ULL,
+	0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490a000084ULL,
+	0x0080002000504000ULL, 0x200020005000c000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+	0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+	0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+	0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+	0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040a100021ULL,
+	0x000200282410a102ULL, 0x000200282410a102ULL, 0x000200282410a102ULL, 0x4048240043802106ULL,
+};
+
+// Fill the magic entries and the attack table of one slider
+static void init_magics(Magic magics[], Bitboard table[], const Bitboard magic_numbers[], const int directions[][2]) {
+	int size = 0;
+	for (Square sq = 0; sq < NUM_SQUARES; sq++) {
+		Magic *m = &magics[sq];
+		// Edge squares never block anything beyond themselves, unless the piece stands on that edge
+		Bitboard edges = ((RANK_1_BB | RANK_8_BB) & ~RANK_BB(rank_of(sq))) |
+		                 ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << file_of(sq)));
+		m->mask = ray_attacks(sq, 0, directions, 4) & ~edges;
+		m->magic = magic_numbers[sq];
+		m->shift = 64 - popcount(m->mask);
+		m->attacks = (sq == 0) ? table : magics[sq - 1].attacks + size;
+
+		// Enumerate every subset of the mask (Carry-Rippler) and store its attack set
+		Bitboard b = 0;
+		size = 0;
+		do {
+			m->attacks[magic_index(m, b)] = ray_attacks(sq, b, directions, 4);
+			size++;
+			b = (b - m->mask) & m->mask;
+		} while (b);
+	}
+}
+
+void init_bitboards(void) {
+	static const int white_pawn[2][2] = { {-1,+1},{+1,+1} };
+	static const int black_pawn[2][2] = { {-1,-1},{+1,-1} };
+	for (Square sq = 0; sq < NUM_SQUARES; sq++) {
+		knight_attacks[sq] = leaper_attacks(sq, KN, 8);
+		king_attacks[sq] = leaper_attacks(sq, QDIR, 8);
+		pawn_attacks[WHITE][sq] = leaper_attacks(sq, white_pawn, 2);
+		pawn_attacks[BLACK][sq] = leaper_attacks(sq, black_pawn, 2);
+	}
+	init_magics(bishop_magics, bishop_table, bishop_magic_numbers, BDIR);
+	init_magics(rook_magics, rook_table, rook_magic_numbers, RDIR);
+
+	for (Square s1 = 0; s1 < NUM_SQUARES; s1++) {
+		for (Square s2 = 0; s2 < NUM_SQUARES; s2++) {
+			Bitboard both = sq_bb(s1) | sq_bb(s2);
+			if (s1 == s2) continue;
+			if (bishop_attacks(s1, 0) & sq_bb(s2)) {
+				line_bb[s1][s2] = (bishop_attacks(s1, 0) & bishop_attacks(s2, 0)) | both;
+				between_bb[s1][s2] = bishop_attacks(s1, sq_bb(s2)) & bishop_attacks(s2, sq_bb(s1));
+			} else if (rook_attacks(s1, 0) & sq_bb(s2)) {
+				line_bb[s1][s2] = (rook_attacks(s1, 0) & rook_attacks(s2, 0)) | both;
+				between_bb[s1][s2] = rook_attacks(s1, sq_bb(s2)) & rook_attacks(s2, sq_bb(s1));
+			}
+		}
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include "tchess.h"
+
+#ifdef USE_PEXT
+#include <immintrin.h> // _pext_u64, build with -mbmi2
+#endif
+
+// Files and ranks (a8 is bit 0, so rank 8 is the lowest byte)
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB (FILE_A_BB << 7)
+#define RANK_8_BB 0x00000000000000FFULL
+#define RANK_1_BB (RANK_8_BB << 56)
+#define RANK_BB(r) (RANK_8_BB << (8 * (7 - (r)))) // r = 0..7 for ranks 1..8
+#define DARK_SQUARES_BB 0x55AA55AA55AA55AAULL    // a1, c1, ..., h8
+
+// Precomputed attack tables, filled by init_bitboards()
+extern Bitboard knight_attacks[NUM_SQUARES];
+extern Bitboard king_attacks[NUM_SQUARES];
+extern Bitboard pawn_attacks[2][NUM_SQUARES]; // squares attacked by a pawn of the given color
+extern Bitboard between_bb[NUM_SQUARES][NUM_SQUARES]; // squares strictly between two aligned squares
+extern Bitboard line_bb[NUM_SQUARES][NUM_SQUARES];    // whole line through two aligned squares, 0 if not aligned
+
+// Sliding attacks: the relevant occupancy of a square is hashed (magic multiplication,
+// or the BMI2 pext instruction when built with USE_PEXT) into a slice of a shared table
+typedef struct {
+	Bitboard mask;     // relevant occupancy, board edges excluded
+	Bitboard magic;
+	Bitboard *attacks; // this square's slice of the attack table
+	int shift;
+} Magic;
+
+extern Magic bishop_magics[NUM_SQUARES];
+extern Magic rook_magics[NUM_SQUARES];
+
+void init_bitboards(void); // Must be called once before any other function here
+
+static inline unsigned magic_index(const Magic *m, Bitboard occupied) {
+#ifdef USE_PEXT
+	return (unsigned)_pext_u64(occupied, m->mask);
+#else
+	return (unsigned)(((occupied & m->mask) * m->magic) >> m->shift);
+#endif
+}
+
+static inline Bitboard bishop_attacks(Square sq, Bitboard occupied) {
+	const Magic *m = &bishop_magics[sq];
+	return m->attacks[magic_index(m, occupied)];
+}
+
+static inline Bitboard rook_attacks(Square sq, Bitboard occupied) {
+	const Magic *m = &rook_magics[sq];
+	return m->attacks[magic_index(m, occupied)];
+}
+
+static inline Bitboard queen_attacks(Square sq, Bitboard occupied) {
+	return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied);
+}
+
+static inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+static inline Square lsb(Bitboard b) { return (Square)__builtin_ctzll(b); }
+static inline Square pop_lsb(Bitboard *b) {
+	Square s = lsb(*b);
+	*b &= *b - 1;
+	return s;
+}
+
+// Shift a whole set one step; offsets match the direction enum in directions.h
+static inline Bitboard shift_bb(Bitboard b, int dir) {
+	switch (dir) {
+		case -8: return b >> 8;                  // N
+		case +8: return b << 8;                  // S
+		case +1: return (b & ~FILE_H_BB) << 1;   // E
+		case -1: return (b & ~FILE_A_BB) >> 1;   // W
+		case -7: return (b & ~FILE_H_BB) >> 7;   // NE
+		case -9: return (b & ~FILE_A_BB) >> 9;   // NW
+		case +9: return (b & ~FILE_H_BB) << 9;   // SE
+		case +7: return (b & ~FILE_A_BB) << 7;   // SW
+		default: return 0;
+	}
+}
+
+#endif // BITBOARD_H
@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 200809L // mmap, fstat
+#include "chunks.h"
+#include "threadpool.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHUNK_BYTES (1 << 20)  // input handed to a worker at a time
+#define CHUNKS_PER_THREAD 4    // chunks per round, so that a slow chunk doesn't idle the others
+
+bool chunk_append(Chunk *c, const char *text, size_t n) {
+	if (c->out_length + n > c->out_capacity) {
+		size_t capacity = c->out_capacity ? 2 * c->out_capacity : 4096;
+		while (capacity < c->out_length + n) capacity *= 2;
+		char *out = realloc(c->out, capacity);
+		if (!out) return false;
+		c->out = out;
+		c->out_capacity = capacity;
+	}
+	memcpy(c->out + c->out_length, text, n);
+	c->out_length += n;
+	return true;
+}
+
+typedef struct {
+	Chunk *chunks;
+	ChunkFn fn;
+} Round;
+
+static void run_chunk(void *ctx, size_t index, int worker) {
+	(void)worker;
+	Round *r = ctx;
+	r->fn(&r->chunks[index]);
+}
+
+static int run_chunks(const char *data, size_t size, int threads, ChunkCutFn cut, ChunkFn fn,
+                      size_t totals[CHUNK_COUNTERS]) {
+	int per_round = threads * CHUNKS_PER_THREAD;
+	Round r = { calloc((size_t)per_round, sizeof(Chunk)), fn };
+	if (!r.chunks) return EXIT_FAILURE;
+
+	const char *p = data, *end = data + size;
+	while (p < end) {
+		int count = 0;
+		for (; count < per_round && p < end; count++) {
+			Chunk *c = &r.chunks[count];
+			c->begin = p;
+			c->end = (size_t)(end - p) > CHUNK_BYTES ? cut(p + CHUNK_BYTES, end) : end;
+			c->out_length = 0;
+			memset(c->counts, 0, sizeof(c->counts));
+			p = c->end;
+		}
+		pool_run(threads, (size_t)count, run_chunk, &r);
+		for (int i = 0; i < count; i++) {
+			fwrite(r.chunks[i].out, 1, r.chunks[i].out_length, stdout);
+			for (int j = 0; j < CHUNK_COUNTERS; j++) totals[j] += r.chunks[i].counts[j];
+		}
+	}
+	fflush(stdout);
+
+	for (int i = 0; i < per_round; i++) free(r.chunks[i].out);
+	free(r.chunks);
+	return EXIT_SUCCESS;
+}
+
+int chunks_run_file(const char *path, int threads, ChunkCutFn cut, ChunkFn fn, size_t totals[CHUNK_COUNTERS]) {
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		if (fd >= 0) close(fd);
+		return EXIT_FAILURE;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return EXIT_SUCCESS;
+	}
+	size_t size = (size_t)st.st_size;
+	char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		fprintf(stderr, "Cannot map %s\n", path);
+		return EXIT_FAILURE;
+	}
+	posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+	int result = run_chunks(data, size, threads, cut, fn, totals);
+	munmap(data, size);
+	return result;
+}
@@ -0,0 +1,33 @@
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Line-oriented files (batch, pgn) are mapped and cut into chunks of about CHUNK_BYTES at
+// record boundaries. The chunks run on the thread pool in rounds, and each round's output is
+// written to stdout in file order before the next one starts.
+
+#define CHUNK_COUNTERS 3 // counters a chunk may keep, summed over the file
+
+// A slice of the file, whole records only, and what it prints
+typedef struct {
+	const char *begin;
+	const char *end;
+	char *out;
+	size_t out_length;
+	size_t out_capacity;
+	size_t counts[CHUNK_COUNTERS];
+} Chunk;
+
+// First record boundary at or after p, or end
+typedef const char *(*ChunkCutFn)(const char *p, const char *end);
+typedef void (*ChunkFn)(Chunk *c);
+
+bool chunk_append(Chunk *c, const char *text, size_t n);
+
+// Run fn on every chunk of the file at path on threads threads, adding the chunks' counters
+// to totals. Returns EXIT_FAILURE (after a message on stderr) if the file cannot be read.
+int chunks_run_file(const char *path, int threads, ChunkCutFn cut, ChunkFn fn, size_t totals[CHUNK_COUNTERS]);
+
+#endif // CHUNKS_H
@@ -0,0 +1,148 @@
+#include "eval.h"
+#include "bitboard.h"
+#include <stddef.h>
+
+const int piece_value[KING + 1] = { 0, 100, 320, 330, 500, 900, 0 };
+
+int psqt_mg[NUM_PIECES][NUM_SQUARES];
+int psqt_eg[NUM_PIECES][NUM_SQUARES];
+
+const int phase_weight[NUM_PIECES] = { 0, 0, 1, 1, 2, 4, 0, 0, 1, 1, 2, 4, 0 };
+
+// Material, tuned separately for the two phases
+static const int material_mg[KING + 1] = { 0, 82, 337, 365, 477, 1025, 0 };
+static const int material_eg[KING + 1] = { 0, 94, 281, 297, 512, 936, 0 };
+
+// Piece-square tables for white, laid out like the board from a8 to h1 (the square order).
+// Black uses the same tables flipped vertically.
+static const int pawn_mg[NUM_SQUARES] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	 50,  50,  50,  50,  50,  50,  50,  50,
+	 10,  10,  20,  30,  30,  20,  10,  10,
+	  5,   5,  10,  25,  25,  10,   5,   5,
+	  0,   0,   0,  20,  20,   0,   0,   0,
+	  5,  -5, -10,   0,   0, -10,  -5,   5,
+	  5,  10,  10, -20, -20,  10,  10,   5,
+	  0,   0,   0,   0,   0,   0,   0,   0
+};
+static const int pawn_eg[NUM_SQUARES] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	 80,  80,  80,  80,  80,  80,  80,  80,
+	 50,  50,  50,  50,  50,  50,  50,  50,
+	 30,  30,  30,  30,  30,  30,  30,  30,
+	 15,  15,  15,  15,  15,  15,  15,  15,
+	  5,   5,   5,   5,   5,   5,   5,   5,
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	  0,   0,   0,   0,   0,   0,   0,   0
+};
+static const int knight_psqt[NUM_SQUARES] = {
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20,   0,   0,   0,   0, -20, -40,
+	-30,   0,  10,  15,  15,  10,   0, -30,
+	-30,   5,  15,  20,  20,  15,   5, -30,
+	-30,   0,  15,  20,  20,  15,   0, -30,
+	-30,   5,  10,  15,  15,  10,   5, -30,
+	-40, -20,   0,   5,   5,   0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50
+};
+static const int bishop_psqt[NUM_SQUARES] = {
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,  10,  10,   5,   0, -10,
+	-10,   5,   5,  10,  10,   5,   5, -10,
+	-10,   0,  10,  10,  10,  10,   0, -10,
+	-10,  10,  10,  10,  10,  10,  10, -10,
+	-10,   5,   0,   0,   0,   0,   5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20
+};
+static const int rook_psqt[NUM_SQUARES] = {
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	  5,  10,  10,  10,  10,  10,  10,   5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	  0,   0,   0,   5,   5,   0,   0,   0
+};
+static const int queen_psqt[NUM_SQUARES] = {
+	-20, -10, -10,  -5,  -5, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,   5,   5,   5,   0, -10,
+	 -5,   0,   5,   5,   5,   5,   0,  -5,
+	  0,   0,   5,   5,   5,   5,   0,  -5,
+	-10,   5,   5,   5,   5,   5,   0, -10,
+	-10,   0,   5,   0,   0,   0,   0, -10,
+	-20, -10, -10,  -5,  -5, -10, -10, -20
+};
+static const int king_mg[NUM_SQUARES] = {
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	 20,  20,   0,   0,   0,   0,  20,  20,
+	 20,  30,  10,   0,   0,  10,  30,  20
+};
+static const int king_eg[NUM_SQUARES] = {
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10,   0,   0, -10, -20, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -30,   0,   0,   0,   0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50
+};
+
+static const int *const tables_mg[KING + 1] = { NULL, pawn_mg, knight_psqt, bishop_psqt, rook_psqt, queen_psqt, king_mg };
+static const int *const tables_eg[KING + 1] = { NULL, pawn_eg, knight_psqt, bishop_psqt, rook_psqt, queen_psqt, king_eg };
+
+void init_eval(void) {
+	for (PieceType t = PAWN; t <= KING; t++) {
+		for (Square sq = 0; sq < NUM_SQUARES; sq++) {
+			Square flipped = sq ^ 56; // same file, mirrored rank
+			psqt_mg[make_piece(WHITE, t)][sq] = material_mg[t] + tables_mg[t][sq];
+			psqt_eg[make_piece(WHITE, t)][sq] = material_eg[t] + tables_eg[t][sq];
+			psqt_mg[make_piece(BLACK, t)][sq] = -(material_mg[t] + tables_mg[t][flipped]);
+			psqt_eg[make_piece(BLACK, t)][sq] = -(material_eg[t] + tables_eg[t][flipped]);
+		}
+	}
+}
+
+#define ROOK_OPEN_FILE_MG      20 // no pawn at all on the rook's file
+#define ROOK_OPEN_FILE_EG      10
+#define ROOK_SEMI_OPEN_FILE_MG 10 // only enemy pawns on it
+#define ROOK_SEMI_OPEN_FILE_EG  5
+
+// Terms built on the pawn entry: king shelter and rooks on open files, for color c
+static void evaluate_pieces(const Position *pos, const PawnEntry *pe, Color c, int *mg, int *eg) {
+	Square king = pos->king_sq[c];
+	if (rank_of(king) == (c == WHITE ? 0 : 7)) *mg += pe->shelter[c][file_of(king)];
+
+	Bitboard rooks = pos->pieces[make_piece(c, ROOK)];
+	while (rooks) {
+		int file_bit = 1 << file_of(pop_lsb(&rooks));
+		if (!(pe->semi_open[c] & file_bit)) continue;
+		bool open = pe->semi_open[!c] & file_bit;
+		*mg += open ? ROOK_OPEN_FILE_MG : ROOK_SEMI_OPEN_FILE_MG;
+		*eg += open ? ROOK_OPEN_FILE_EG : ROOK_SEMI_OPEN_FILE_EG;
+	}
+}
+
+// Blend of the middlegame and endgame scores by how much material is left
+int evaluate(const Position *pos, PawnTable *pawns) {
+	PawnEntry scratch;
+	const PawnEntry *pe = pawn_probe(pawns, pos, &scratch);
+	int mg[2] = {0, 0};
+	int eg[2] = {0, 0};
+	evaluate_pieces(pos, pe, WHITE, &mg[WHITE], &eg[WHITE]);
+	evaluate_pieces(pos, pe, BLACK, &mg[BLACK], &eg[BLACK]);
+	int score_mg = pos->score_mg + pe->score_mg + mg[WHITE] - mg[BLACK];
+	int score_eg = pos->score_eg + pe->score_eg + eg[WHITE] - eg[BLACK];
+
+	int phase = pos->phase < PHASE_MAX ? pos->phase : PHASE_MAX; // extra queens count as full
+	int score = (score_mg * phase + score_eg * (PHASE_MAX - phase)) / PHASE_MAX;
+	return pos->side_to_move == WHITE ? score : -score;
+}
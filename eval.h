@@ -0,0 +1,25 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "tchess.h"
+#include "pawns.h"
+
+// Piece values in centipawns, indexed by PieceType (the king has none)
+extern const int piece_value[KING + 1];
+
+// Material plus piece-square bonus of a piece on a square, for the middlegame and the
+// endgame, from white's point of view (black pieces count negative). Filled by init_eval();
+// make_move keeps their sums in Position.
+extern int psqt_mg[NUM_PIECES][NUM_SQUARES];
+extern int psqt_eg[NUM_PIECES][NUM_SQUARES];
+// Game phase: each piece's share of the non-pawn material, PHASE_MAX with all of it on the board
+extern const int phase_weight[NUM_PIECES];
+#define PHASE_MAX 24
+
+void init_eval(void); // Must be called once before positions are set up
+
+// Static evaluation in centipawns, from the side to move's point of view; pawns (may be NULL)
+// caches the pawn-structure terms
+int evaluate(const Position *pos, PawnTable *pawns);
+
+#endif // EVAL_H
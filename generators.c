@@ -1,250 +1,183 @@
 #include "directions.h"
 #include "tchess.h"
+#include "bitboard.h"
 #include "generators.h"
 #include <stdio.h>
-#include <stdlib.h>
 
 // -- GENERATOR MOVES --
 
-// Pawn
-static void gen_pawn(const Position *pos, Square sq, MoveList *list) {
-	char promos[] = {'q', 'r', 'b', 'n'};
-	Piece p = at(pos, sq);
-	Color c = piece_color(p);
-	int file = file_of(sq);
-	int rank = rank_of(sq);
-	// Forward moves 
-	int r1 = rank + 1 * ((c == WHITE) ? 1 : -1);
-	Square to = SQ(file, r1);
-	if (in_board(file, r1) && at(pos, to) == NO_PIECE){
-		// Normal move, check for promotion
-		if (r1 == 7 || r1 == 0) {
-			// Promotions
-			char promos[] = {'q', 'r', 'b', 'n'};
-			for (int i = 0; i < 4; i++) {
-				Move m = (Move){sq, to, PROMOTION, promos[i]};
-				add_move(list, m);
-			}
-		} else {
-			Move m = {sq, to, NORMAL, NO_PIECE};
-			add_move(list, m);
-			// Double move from starting rank
-			if (rank == 1 || rank == 6) {
-				int r2 = rank + 2 * ((c == WHITE) ? 1 : -1);
-				Square to2 = SQ(file, r2);
-				if (at(pos, to2) == NO_PIECE) {
-					Move m2 = (Move){sq, to2, NORMAL, NO_PIECE};
-					add_move(list, m2);
-				}
-			}
-		}
-	}
-	// Captures
-	if (in_board(file - 1, r1) && in_board(file + 1, r1)) {
-		Square cap_left = SQ(file - 1, r1);
-		Square cap_right = SQ(file + 1, r1);
-
-		Piece l_p = at(pos, cap_left);
-		Piece r_p = at(pos, cap_right);
-
-		if (l_p != NO_PIECE && piece_color(l_p) != c) {
-			// Capture left, check for promotion
-			if (r1 == 7 || r1 == 0) {
-				for (int i = 0; i < 4; i++) {
-					Move m = (Move){sq, cap_left, PROMOTION, promos[i]};
-					add_move(list, m);
-				}
-			} else {
-				Move m = (Move){sq, cap_left, NORMAL, NO_PIECE};
-				add_move(list, m);
-			}
-		}
-		if (r_p != NO_PIECE && piece_color(r_p) != c) {
-			// Capture right, check for promotion
-			if (r1 == 7 || r1 == 0) {
-				for (int i = 0; i < 4; i++) {
-					Move m = (Move){sq, cap_right, PROMOTION, promos[i]};
-					add_move(list, m);
-				}
-			} else {
-				Move m = (Move){sq, cap_right, NORMAL, NO_PIECE};
-				add_move(list, m);
-			}
-		}
-		
+// Add one move per target square, all starting from the same square
+static void add_moves_from(Square from, Bitboard targets, Bitboard enemies, MoveList *list) {
+	while (targets) {
+		Square to = pop_lsb(&targets);
+		Move m = new_move(from, to, (enemies & sq_bb(to)) ? FLAG_CAPTURE : FLAG_QUIET);
+		add_move(list, m);
 	}
+}
 
-	// En Passant
-	if (pos->en_passant_target != NO_SQUARE) {
-		int epf = file_of(pos->en_passant_target), epr = rank_of(pos->en_passant_target);
-		if (c == WHITE){
-			if ((epr == rank+1) && (epf == file - 1 || epf == file + 1)) {
-				Move m = (Move){sq, pos->en_passant_target, EN_PASSANT, NO_PIECE};
-				add_move(list, m);
-			}
-		}
-		else {
-			if ((epr == rank-1) && (epf == file - 1 || epf == file + 1)) {
-				Move m = (Move){sq, pos->en_passant_target, EN_PASSANT, NO_PIECE};
-				add_move(list, m);
-			}
-		}
+// Add the four promotions of a pawn landing on 'to' (queen first); flags is FLAG_PROMOTION
+// or FLAG_PROMOTION_CAPTURE
+static void add_promotions(Square from, Square to, int flags, MoveList *list) {
+	for (int i = 3; i >= 0; i--) {
+		add_move(list, new_move(from, to, flags + i));
 	}
 }
 
-// Knight
-static void gen_knight(const Position *pos, Square sq, MoveList *list) {
-	Piece p = at(pos, sq);
-	Color c = piece_color(p);
-	int file = file_of(sq);
-	int rank = rank_of(sq);
-	for (int i = 0; i < 8; i++) {
-		int df = KN[i][0];
-		int dr= KN[i][1];
-		if (!in_board(file + df, rank + dr)) continue;
-
-		int nf = file + df;
-		int nr = rank + dr;
-		Square sq_to = SQ(nf, nr);
-		Piece target = at(pos, sq_to);
-
-		if (target == NO_PIECE) {
-			Move m = (Move){sq, sq_to, NORMAL, NO_PIECE};
-			add_move(list, m);
-		}
-		else if (target != NO_PIECE && piece_color(target) != c) {
-			Move m = (Move){sq, sq_to, CAPTURE, NO_PIECE};
-			add_move(list, m);
-		}
-	}
+// Only lets a pinned piece move along the line through its king
+static inline Bitboard pin_filter(Square from, Bitboard targets, Bitboard pinned, Square king_sq) {
+	return (pinned & sq_bb(from)) ? targets & line_bb[king_sq][from] : targets;
 }
 
-// Sliding pieces
-static void gen_slider(const Position *pos, Square sq, MoveList *list, const int directions[][2], int num_dirs) {
-	Piece p = at(pos, sq);
-	Color c = piece_color(p);
-	int file = file_of(sq);
-	int rank = rank_of(sq);
-	for (int i = 0; i < num_dirs; i++) {
-		int df = directions[i][0];
-		int dr = directions[i][1];
-		int f = file + df;
-		int r = rank + dr;
-		while (in_board(f, r)) {
-			Square sq_to = SQ(f, r);
-			Piece target = at(pos, sq_to);
-			if (target == NO_PIECE) {
-				Move m = (Move){sq, sq_to, NORMAL, NO_PIECE};
-				add_move(list, m);
+// Pawns, generated set-wise: every pawn of the side is pushed/captured at once.
+// Only moves landing on 'target' are generated; pinned pawns stay on their pin line.
+// GEN_CAPTURES gives captures and all promotions, GEN_QUIETS the other pushes.
+static void gen_pawns(const Position *pos, MoveList *list, Bitboard target, Bitboard pinned, Square king_sq,
+                      GenType type) {
+	Color c = pos->side_to_move;
+	Bitboard pawns = pos->pieces[make_piece(c, PAWN)];
+	Bitboard empty = ~pos->occupied;
+	Bitboard enemies = pos->colors[!c];
+	Bitboard promo_rank = (c == WHITE) ? RANK_8_BB : RANK_1_BB;
+	Bitboard double_rank = (c == WHITE) ? RANK_BB(2) : RANK_BB(5); // rank reached by the first step
+	int up = (c == WHITE) ? N : S;
+	int up_east = (c == WHITE) ? NE : SE;
+	int up_west = (c == WHITE) ? NW : SW;
+
+	// Forward moves
+	Bitboard single = shift_bb(pawns, up) & empty;
+	Bitboard dbl = shift_bb(single & double_rank, up) & empty & target;
+	single &= target;
+	Bitboard b = single & ~promo_rank;
+	if (type == GEN_CAPTURES) b = dbl = 0;
+	while (b) {
+		Square to = pop_lsb(&b);
+		if (!pin_filter(to - up, sq_bb(to), pinned, king_sq)) continue;
+		add_move(list, new_move(to - up, to, FLAG_QUIET));
+	}
+	while (dbl) {
+		Square to = pop_lsb(&dbl);
+		if (!pin_filter(to - 2 * up, sq_bb(to), pinned, king_sq)) continue;
+		add_move(list, new_move(to - 2 * up, to, FLAG_DOUBLE_PUSH));
+	}
+	if (type == GEN_QUIETS) return;
+	b = single & promo_rank;
+	while (b) {
+		Square to = pop_lsb(&b);
+		if (!pin_filter(to - up, sq_bb(to), pinned, king_sq)) continue;
+		add_promotions(to - up, to, FLAG_PROMOTION, list);
+	}
+
+	// Captures
+	const int cap_dirs[2] = {up_east, up_west};
+	for (int i = 0; i < 2; i++) {
+		Bitboard caps = shift_bb(pawns, cap_dirs[i]) & enemies & target;
+		while (caps) {
+			Square to = pop_lsb(&caps);
+			Square from = to - cap_dirs[i];
+			if (!pin_filter(from, sq_bb(to), pinned, king_sq)) continue;
+			if (sq_bb(to) & promo_rank) {
+				add_promotions(from, to, FLAG_PROMOTION_CAPTURE, list);
 			} else {
-				if (piece_color(target) != c) {
-					Move m = (Move){sq, sq_to, CAPTURE, NO_PIECE};
-					add_move(list, m);
-				}
-				break; // Stop sliding on capture or blocked
+				add_move(list, new_move(from, to, FLAG_CAPTURE));
 			}
-			f += df;
-			r += dr;
 		}
-	
 	}
 }
 
-// Normal King moves
-static void gen_king(const Position *pos, Square sq, MoveList *list) {
-	Piece p = at(pos, sq);
-	Color c = piece_color(p);
-	int file = file_of(sq);
-	int rank = rank_of(sq);
-	for (int df = -1; df <= 1; df++) 
-		for (int dr = -1; dr <= 1; dr++) {
-			if (df == 0 && dr == 0) continue;
-			int f = file + df;
-			int r = rank + dr;
-			if (in_board(f, r)) {
-				Square sq_to = SQ(f, r);
-				Piece target = at(pos, sq_to);
-				if (target == NO_PIECE) {
-					Move m = (Move){sq, sq_to, NORMAL, NO_PIECE};
-					add_move(list, m);
-				}
-				else if (piece_color(target) != c) {
-					Move m = (Move){sq, sq_to, CAPTURE, NO_PIECE};
-					add_move(list, m);
-				}
-			}
+// Attackers of the given color on sq, with 'occupied' standing in for the board occupancy
+static Bitboard attackers_of(const Position *pos, Square sq, Color c, Bitboard occupied) {
+	const Bitboard *pc = pos->pieces;
+	Bitboard queens = pc[make_piece(c, QUEEN)];
+	return ((pawn_attacks[!c][sq] & pc[make_piece(c, PAWN)]) |
+	        (knight_attacks[sq] & pc[make_piece(c, KNIGHT)]) |
+	        (bishop_attacks(sq, occupied) & (pc[make_piece(c, BISHOP)] | queens)) |
+	        (rook_attacks(sq, occupied) & (pc[make_piece(c, ROOK)] | queens)) |
+	        (king_attacks[sq] & pc[make_piece(c, KING)])) & occupied;
+}
+
+// En passant. When 'legal' is set, each capture is checked by removing both pawns from the
+// occupancy: this catches pins along the rank and checks it doesn't resolve.
+static void gen_en_passant(const Position *pos, MoveList *list, bool legal, Square king_sq) {
+	if (pos->en_passant_target == NO_SQUARE) return;
+	Color c = pos->side_to_move;
+	Square to = pos->en_passant_target;
+	Square taken_sq = (c == WHITE) ? to + S : to + N;
+	Bitboard attackers = pawn_attacks[!c][to] & pos->pieces[make_piece(c, PAWN)];
+	while (attackers) {
+		Square from = pop_lsb(&attackers);
+		if (legal) {
+			Bitboard occ = (pos->occupied ^ sq_bb(from) ^ sq_bb(taken_sq)) | sq_bb(to);
+			if (attackers_of(pos, king_sq, !c, occ)) continue;
 		}
+		add_move(list, new_move(from, to, FLAG_EN_PASSANT));
+	}
+}
 
+// Knights, bishops, rooks and queens: table lookups per piece, restricted to 'target'
+static void gen_pieces(const Position *pos, MoveList *list, Bitboard target, Bitboard pinned, Square king_sq) {
+	Color c = pos->side_to_move;
+	Bitboard enemies = pos->colors[!c];
+	Bitboard occ = pos->occupied;
+
+	Bitboard b = pos->pieces[make_piece(c, KNIGHT)] & ~pinned; // a pinned knight can never move
+	while (b) {
+		Square sq = pop_lsb(&b);
+		add_moves_from(sq, knight_attacks[sq] & target, enemies, list);
+	}
+	b = pos->pieces[make_piece(c, BISHOP)] | pos->pieces[make_piece(c, QUEEN)];
+	while (b) {
+		Square sq = pop_lsb(&b);
+		add_moves_from(sq, pin_filter(sq, bishop_attacks(sq, occ) & target, pinned, king_sq), enemies, list);
+	}
+	b = pos->pieces[make_piece(c, ROOK)] | pos->pieces[make_piece(c, QUEEN)];
+	while (b) {
+		Square sq = pop_lsb(&b);
+		add_moves_from(sq, pin_filter(sq, rook_attacks(sq, occ) & target, pinned, king_sq), enemies, list);
+	}
 }
 
 // Castling moves
 static void gen_castling(const Position *pos, MoveList *list) {
+	Bitboard occ = pos->occupied;
 	if (pos->side_to_move == WHITE) {
 		// Kingside
 		if ((pos->castling_rights & WHITE_KING_SIDE_CASTLING) &&
-			at(pos, F1) == NO_PIECE && at(pos, G1) == NO_PIECE) {
-			Move m = {E1, G1, CASTLING_KINGSIDE, NO_PIECE};
+			!(occ & (sq_bb(F1) | sq_bb(G1)))) {
+			Move m = new_move(E1, G1, FLAG_KING_CASTLE);
 			add_move(list, m);
 		}
 		// Queenside
 		if ((pos->castling_rights & WHITE_QUEEN_SIDE_CASTLING) &&
-			at(pos, D1) == NO_PIECE && at(pos, C1) == NO_PIECE && at(pos, B1) == NO_PIECE) {
-			Move m = {E1, C1, CASTLING_QUEENSIDE, NO_PIECE};
+			!(occ & (sq_bb(D1) | sq_bb(C1) | sq_bb(B1)))) {
+			Move m = new_move(E1, C1, FLAG_QUEEN_CASTLE);
 			add_move(list, m);
 		}
 	} else {
 		// Kingside
 		if ((pos->castling_rights & BLACK_KING_SIDE_CASTLING) &&
-			at(pos, F8) == NO_PIECE && at(pos, G8) == NO_PIECE) {
-			Move m = {E8, G8, CASTLING_KINGSIDE, NO_PIECE};
+			!(occ & (sq_bb(F8) | sq_bb(G8)))) {
+			Move m = new_move(E8, G8, FLAG_KING_CASTLE);
 			add_move(list, m);
 		}
 		// Queenside
 		if ((pos->castling_rights & BLACK_QUEEN_SIDE_CASTLING) &&
-			at(pos, D8) == NO_PIECE && at(pos, C8) == NO_PIECE && at(pos, B8) == NO_PIECE) {
-			Move m = {E8, C8, CASTLING_QUEENSIDE, NO_PIECE};
+			!(occ & (sq_bb(D8) | sq_bb(C8) | sq_bb(B8)))) {
+			Move m = new_move(E8, C8, FLAG_QUEEN_CASTLE);
 			add_move(list, m);
 		}
 	}
 }
 
-// Based on the piece on the given square, we will call the appropriate generator
-static void gen_piece_moves(const Position *pos, Square sq, MoveList *list) {
-	Piece p = at(pos, sq);
-	switch (piece_type(p)) {
-		case PAWN:
-			gen_pawn(pos, sq, list);
-			break;
-		case KNIGHT:
-			gen_knight(pos, sq, list);
-			break;
-		case BISHOP:
-			gen_slider(pos, sq, list, BDIR, 4);
-			break;
-		case ROOK:
-			gen_slider(pos, sq, list, RDIR, 4);
-			break;
-		case QUEEN:
-			gen_slider(pos, sq, list, QDIR, 8);
-			break;
-		case KING:
-			gen_king(pos, sq, list);
-			break;
-		default:
-			break;
-	}	
-}
-
 // Generate all pseudo-legal moves for the side to move
 void generate_pseudo_legal_moves(const Position *pos, MoveList *ml) {
-	ml->count = 0;
 	Color us = pos->side_to_move;
-	for (Square sq = 0; sq < NUM_SQUARES; sq++) {
-		Piece p = at(pos, sq);
-		if (p != NO_PIECE && piece_color(p) == us) {
-			gen_piece_moves(pos, sq, ml);
-		}
-	}
+	Bitboard target = ~pos->colors[us];
+	Square king_sq = pos->king_sq[us];
+	ml->count = 0;
+	gen_pawns(pos, ml, target, 0, king_sq, GEN_ALL);
+	gen_en_passant(pos, ml, false, king_sq);
+	gen_pieces(pos, ml, target, 0, king_sq);
+	add_moves_from(king_sq, king_attacks[king_sq] & target, pos->colors[!us], ml);
 	gen_castling(pos, ml);
 }
 
@@ -272,40 +205,250 @@ static bool castle_path_safe(const Position* pos, Color side, bool kingside) {
     return true;
 }
 
-void generate_legal(const Position* pos, MoveList* ml) {
-	MoveList *pseudo_legal = malloc(sizeof(MoveList));
-	generate_pseudo_legal_moves(pos, pseudo_legal);
-	ml->count = 0;
+// Our pieces standing alone between our king and an enemy slider
+static Bitboard pinned_pieces(const Position *pos, Color us, Square king_sq) {
+	const Bitboard *pc = pos->pieces;
+	Color them = !us;
+	Bitboard queens = pc[make_piece(them, QUEEN)];
+	Bitboard snipers = (rook_attacks(king_sq, 0) & (pc[make_piece(them, ROOK)] | queens)) |
+	                   (bishop_attacks(king_sq, 0) & (pc[make_piece(them, BISHOP)] | queens));
+	Bitboard pinned = 0;
+	while (snipers) {
+		Bitboard blockers = between_bb[king_sq][pop_lsb(&snipers)] & pos->occupied;
+		if (blockers && !(blockers & (blockers - 1))) pinned |= blockers & pos->colors[us];
+	}
+	return pinned;
+}
 
+// Fully legal generation: checkers and pins are computed once, then only legal moves are emitted.
+// In check, the other pieces may only capture the checker or block its ray; in double check
+// only the king moves. King moves and en passant are the only moves tested one by one.
+static void gen_legal(const Position* pos, MoveList* ml, GenType type) {
 	Color us = pos->side_to_move;
-	Square king_sq;
-	
-	for (int i = 0; i < pseudo_legal->count; i++) {
-		Move m = pseudo_legal->list[i];
-		Position *new_pos = malloc(sizeof(Position));
-				
-		*new_pos = *pos; // Copy current position
-		make_move(new_pos, &m); // Make the move	
-								
-		// Get king square
-		king_sq = find_king(new_pos, us);
-
-		// Check if our king is in check in the new position
-		if (!is_square_attacked(new_pos, king_sq, !us)) {
-			// If the move is castling, ensure the path is safe
-			if (m.type == CASTLING_KINGSIDE) {
-				if (castle_path_safe(pos, us, true)) {
-					add_move(ml, m);
-				}
-			} else if (m.type == CASTLING_QUEENSIDE) {
-				if (castle_path_safe(pos, us, false)) {
-					add_move(ml, m);
-				}
-			} else {
-				add_move(ml, m);
+	Color them = !us;
+	Bitboard own = pos->colors[us];
+	Square king_sq = pos->king_sq[us];
+	Bitboard checkers = attackers_of(pos, king_sq, them, pos->occupied);
+	// Squares the wanted kind of move may land on
+	Bitboard kind = type == GEN_CAPTURES ? pos->colors[them] : type == GEN_QUIETS ? ~pos->occupied : ~own;
+	ml->count = 0;
+
+	// King moves, tested with the king off the board so it can't hide behind itself
+	Bitboard occ = pos->occupied ^ sq_bb(king_sq);
+	Bitboard b = king_attacks[king_sq] & kind;
+	while (b) {
+		Square to = pop_lsb(&b);
+		if (attackers_of(pos, to, them, occ)) continue;
+		Move m = new_move(king_sq, to, (pos->colors[them] & sq_bb(to)) ? FLAG_CAPTURE : FLAG_QUIET);
+		add_move(ml, m);
+	}
+	if (checkers & (checkers - 1)) return; // double check
+
+	Bitboard target = ~own;
+	if (checkers) target = between_bb[king_sq][lsb(checkers)] | checkers;
+	Bitboard pinned = pinned_pieces(pos, us, king_sq);
+
+	gen_pawns(pos, ml, target, pinned, king_sq, type);
+	if (type != GEN_QUIETS) gen_en_passant(pos, ml, true, king_sq);
+	gen_pieces(pos, ml, target & kind, pinned, king_sq);
+
+	if (!checkers && type != GEN_CAPTURES) {
+		MoveList castles;
+		castles.count = 0;
+		gen_castling(pos, &castles);
+		for (int i = 0; i < castles.count; i++) {
+			if (castle_path_safe(pos, us, move_flags(castles.list[i]) == FLAG_KING_CASTLE)) {
+				add_move(ml, castles.list[i]);
 			}
 		}
-		free(new_pos);
-		
 	}
 }
+
+void generate_legal(const Position* pos, MoveList* ml) {
+	gen_legal(pos, ml, GEN_ALL);
+}
+
+void generate_legal_captures(const Position* pos, MoveList* ml) {
+	gen_legal(pos, ml, GEN_CAPTURES);
+}
+
+void generate_legal_quiets(const Position* pos, MoveList* ml) {
+	gen_legal(pos, ml, GEN_QUIETS);
+}
+
+// -- COUNTING --
+
+// Number of moves of a set of pawns landing on 'target', counted set-wise like gen_pawns
+// (a promotion counts four times)
+static int count_pawn_moves(const Position *pos, Bitboard pawns, Bitboard target) {
+	Color c = pos->side_to_move;
+	Bitboard empty = ~pos->occupied;
+	Bitboard promo_rank = (c == WHITE) ? RANK_8_BB : RANK_1_BB;
+	Bitboard double_rank = (c == WHITE) ? RANK_BB(2) : RANK_BB(5);
+	int up = (c == WHITE) ? N : S;
+
+	Bitboard single = shift_bb(pawns, up) & empty;
+	Bitboard dbl = shift_bb(single & double_rank, up) & empty & target;
+	single &= target;
+	Bitboard caps = (shift_bb(pawns, c == WHITE ? NE : SE) & pos->colors[!c] & target);
+	Bitboard caps2 = (shift_bb(pawns, c == WHITE ? NW : SW) & pos->colors[!c] & target);
+	return popcount(single & ~promo_rank) + 4 * popcount(single & promo_rank) + popcount(dbl) +
+	       popcount(caps & ~promo_rank) + 4 * popcount(caps & promo_rank) +
+	       popcount(caps2 & ~promo_rank) + 4 * popcount(caps2 & promo_rank);
+}
+
+// The legal moves of gen_legal, counted instead of listed. With 'any', stop as soon as one
+// group of moves is found (the count is then only known to be positive).
+static int count_moves(const Position *pos, bool any) {
+	Color us = pos->side_to_move;
+	Color them = !us;
+	Bitboard own = pos->colors[us];
+	Square king_sq = pos->king_sq[us];
+	Bitboard checkers = attackers_of(pos, king_sq, them, pos->occupied);
+	int n = 0;
+
+	Bitboard occ = pos->occupied ^ sq_bb(king_sq);
+	Bitboard b = king_attacks[king_sq] & ~own;
+	while (b) {
+		if (attackers_of(pos, pop_lsb(&b), them, occ)) continue;
+		n++;
+		if (any) return n;
+	}
+	if (checkers & (checkers - 1)) return n;
+
+	Bitboard target = ~own;
+	if (checkers) target = between_bb[king_sq][lsb(checkers)] | checkers;
+	Bitboard pinned = pinned_pieces(pos, us, king_sq);
+
+	// Free pawns all at once, pinned ones along their pin line
+	Bitboard pawns = pos->pieces[make_piece(us, PAWN)];
+	n += count_pawn_moves(pos, pawns & ~pinned, target);
+	b = pawns & pinned;
+	while (b) {
+		Square sq = pop_lsb(&b);
+		n += count_pawn_moves(pos, sq_bb(sq), target & line_bb[king_sq][sq]);
+	}
+	if (any && n) return n;
+
+	Bitboard knights = pos->pieces[make_piece(us, KNIGHT)] & ~pinned;
+	while (knights) {
+		n += popcount(knight_attacks[pop_lsb(&knights)] & target);
+	}
+	Bitboard queens = pos->pieces[make_piece(us, QUEEN)];
+	b = pos->pieces[make_piece(us, BISHOP)] | queens;
+	while (b) {
+		Square sq = pop_lsb(&b);
+		n += popcount(pin_filter(sq, bishop_attacks(sq, pos->occupied) & target, pinned, king_sq));
+	}
+	b = pos->pieces[make_piece(us, ROOK)] | queens;
+	while (b) {
+		Square sq = pop_lsb(&b);
+		n += popcount(pin_filter(sq, rook_attacks(sq, pos->occupied) & target, pinned, king_sq));
+	}
+	if (any && n) return n;
+
+	MoveList special;
+	special.count = 0;
+	gen_en_passant(pos, &special, true, king_sq);
+	n += special.count;
+	// Castling needs the king's first step to be legal, so it never decides 'any'
+	if (any || checkers) return n;
+	special.count = 0;
+	gen_castling(pos, &special);
+	for (int i = 0; i < special.count; i++) {
+		if (castle_path_safe(pos, us, move_flags(special.list[i]) == FLAG_KING_CASTLE)) n++;
+	}
+	return n;
+}
+
+int count_legal(const Position *pos) {
+	return count_moves(pos, false);
+}
+
+bool has_any_legal_move(const Position *pos) {
+	return count_moves(pos, true) > 0;
+}
+
+// -- SINGLE MOVE CHECKS --
+
+// Whether m is a move of the side to move that the generator could emit here, legal or not:
+// right piece and flags for the squares, a path the piece can take, and for castling the
+// right and an empty path between king and rook
+bool is_pseudo_legal(const Position *pos, Move m) {
+	Color us = pos->side_to_move;
+	Square from = move_from(m), to = move_to(m);
+	int flags = move_flags(m);
+	Piece moving = pos->board[from];
+	Piece target = pos->board[to];
+	if (m == MOVE_NONE || from == to || moving == NO_PIECE || piece_color(moving) != us) return false;
+	if (pos->colors[us] & sq_bb(to)) return false;
+	if (flags > FLAG_EN_PASSANT && !move_is_promotion(m)) return false; // unused flag values
+	PieceType type = piece_type(moving);
+
+	if (move_is_castling(m)) {
+		bool kingside = flags == FLAG_KING_CASTLE;
+		Square home = us == WHITE ? E1 : E8;
+		Square rook = kingside ? home + 3 : home - 4;
+		int right = us == WHITE ? (kingside ? WHITE_KING_SIDE_CASTLING : WHITE_QUEEN_SIDE_CASTLING)
+		                        : (kingside ? BLACK_KING_SIDE_CASTLING : BLACK_QUEEN_SIDE_CASTLING);
+		return type == KING && from == home && to == (kingside ? home + 2 : home - 2) &&
+		       (pos->castling_rights & right) && pos->board[rook] == make_piece(us, ROOK) &&
+		       !(between_bb[from][rook] & pos->occupied);
+	}
+	if (flags == FLAG_EN_PASSANT) {
+		return type == PAWN && to == pos->en_passant_target && (pawn_attacks[us][from] & sq_bb(to)) &&
+		       pos->board[us == WHITE ? to + S : to + N] == make_piece(!us, PAWN);
+	}
+	// The capture flag must match the target square
+	if (move_is_capture(m) != (target != NO_PIECE)) return false;
+
+	if (type == PAWN) {
+		int up = us == WHITE ? N : S;
+		bool last_rank = sq_bb(to) & (us == WHITE ? RANK_8_BB : RANK_1_BB);
+		if (move_is_promotion(m) != last_rank) return false;
+		if (move_is_capture(m)) return pawn_attacks[us][from] & sq_bb(to);
+		if (flags == FLAG_DOUBLE_PUSH) {
+			return rank_of(from) == (us == WHITE ? 1 : 6) && to == from + 2 * up && pos->board[from + up] == NO_PIECE;
+		}
+		return to == from + up;
+	}
+	if (flags != FLAG_QUIET && flags != FLAG_CAPTURE) return false;
+	Bitboard attacks;
+	switch (type) {
+	case KNIGHT: attacks = knight_attacks[from]; break;
+	case BISHOP: attacks = bishop_attacks(from, pos->occupied); break;
+	case ROOK:   attacks = rook_attacks(from, pos->occupied); break;
+	case QUEEN:  attacks = queen_attacks(from, pos->occupied); break;
+	default:     attacks = king_attacks[from]; break;
+	}
+	return attacks & sq_bb(to);
+}
+
+// Whether a pseudo-legal move leaves our king safe: the same tests as the legal generator,
+// for one move
+bool is_legal(const Position *pos, Move m) {
+	Color us = pos->side_to_move;
+	Color them = !us;
+	Square from = move_from(m), to = move_to(m);
+	Square king_sq = pos->king_sq[us];
+
+	if (move_is_castling(m)) return castle_path_safe(pos, us, move_flags(m) == FLAG_KING_CASTLE);
+	if (from == king_sq) return !attackers_of(pos, to, them, pos->occupied ^ sq_bb(king_sq));
+	if (move_flags(m) == FLAG_EN_PASSANT) {
+		Square taken_sq = us == WHITE ? to + S : to + N;
+		Bitboard occ = (pos->occupied ^ sq_bb(from) ^ sq_bb(taken_sq)) | sq_bb(to);
+		return !attackers_of(pos, king_sq, them, occ);
+	}
+
+	// In check, capture the checker or block its ray; never with two checkers
+	Bitboard checkers = attackers_of(pos, king_sq, them, pos->occupied);
+	if (checkers) {
+		if (checkers & (checkers - 1)) return false;
+		if (!((between_bb[king_sq][lsb(checkers)] | checkers) & sq_bb(to))) return false;
+	}
+	// Leaving the line through the king is only a problem for a pinned piece
+	Bitboard line = line_bb[king_sq][from];
+	if (line && !(line & sq_bb(to))) return !(pinned_pieces(pos, us, king_sq) & sq_bb(from));
+	return true;
+}
+
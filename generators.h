@@ -3,16 +3,27 @@
 
 #include "tchess.h"
 
-// Move generation
-// static void gen_pawn(const Position* pos, Square s, MoveList* ml);
-// static void gen_knight(const Position* pos, Square s, MoveList* ml);
-// static void gen_slider(const Position* pos, Square s, MoveList* ml, const int directions[][2], int num_directions);
-// static void gen_king(const Position* pos, Square s, MoveList* ml);
+// Which moves a generator emits: all of them, captures and promotions, or the rest
+typedef enum { GEN_ALL, GEN_CAPTURES, GEN_QUIETS } GenType;
+
+// Move generation (bitboard based, see bitboard.h)
+// static void gen_pawns(const Position* pos, MoveList* ml, Bitboard target, Bitboard pinned, Square king_sq, GenType type);
+// static void gen_en_passant(const Position* pos, MoveList* ml, bool legal, Square king_sq);
+// static void gen_pieces(const Position* pos, MoveList* ml, Bitboard target, Bitboard pinned, Square king_sq);
 // static void gen_castling(const Position* pos, MoveList* ml);
-// static void gen_piece_moves(const Position* pos, Square s, MoveList* ml);
-// static bool caste_path_safe(const Position* pos, Square king_from, Square king_to, Square rook_from, Square rook_to);
+// static bool castle_path_safe(const Position* pos, Color side, bool kingside);
+// static Bitboard pinned_pieces(const Position* pos, Color us, Square king_sq);
 
 // Public move generation functions
 void generate_pseudo_legal_moves(const Position* pos, MoveList* ml); // Generate all pseudo-legal moves for the current position
-void generate_legal(const Position* pos, MoveList* ml); // Generate all legal moves for the current position
+void generate_legal(const Position* pos, MoveList* ml); // Generate all legal moves for the current position (pin/check aware)
+void generate_legal_captures(const Position* pos, MoveList* ml); // Legal captures (en passant included) and promotions
+void generate_legal_quiets(const Position* pos, MoveList* ml);   // The other legal moves, castling included
+int count_legal(const Position* pos);             // Number of legal moves, counted without a list
+bool has_any_legal_move(const Position* pos);     // Stops at the first legal move found
+
+// Single move checks, without generating anything (for moves typed in, or taken from the
+// transposition table or the killer slots)
+bool is_pseudo_legal(const Position* pos, Move m); // Fits the position: piece, flags, path, castling rights
+bool is_legal(const Position* pos, Move m);        // A pseudo-legal move that leaves the king safe
 #endif // GENERATORS_H
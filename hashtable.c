@@ -0,0 +1,16 @@
+#include "hashtable.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_LINE 64
+
+void *hash_alloc(size_t mb, size_t slot_size, uint64_t *mask) {
+	size_t count = 1;
+	while (2 * count * slot_size <= mb * 1024 * 1024) count *= 2;
+	// aligned_alloc wants a multiple of the alignment
+	size_t bytes = (count * slot_size + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+	void *table = aligned_alloc(CACHE_LINE, bytes);
+	if (table) memset(table, 0, bytes);
+	*mask = table ? count - 1 : 0;
+	return table;
+}
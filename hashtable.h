@@ -0,0 +1,33 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Entry of the tables shared by threads without locks (perft hash, transposition table). The
+// first word is the key XORed with the second, so a torn write, with the words of two stores
+// mixed, never validates.
+typedef struct {
+	_Atomic uint64_t check; // key ^ data
+	_Atomic uint64_t data;
+} HashEntry;
+
+// Zeroed table of a power of two slots of slot_size bytes, about mb megabytes, aligned on a
+// cache line (free it with free). *mask receives the number of slots - 1; NULL if out of memory.
+void *hash_alloc(size_t mb, size_t slot_size, uint64_t *mask);
+
+// The entry's data, and whether it was stored under key
+static inline bool hash_entry_read(const HashEntry *e, uint64_t key, uint64_t *data) {
+	*data = atomic_load_explicit(&e->data, memory_order_relaxed);
+	uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+	return (check ^ *data) == key;
+}
+
+static inline void hash_entry_write(HashEntry *e, uint64_t key, uint64_t data) {
+	atomic_store_explicit(&e->check, key ^ data, memory_order_relaxed);
+	atomic_store_explicit(&e->data, data, memory_order_relaxed);
+}
+
+#endif // HASHTABLE_H
@@ -1,50 +1,89 @@
 #include "tchess.h"
 #include "generators.h"
+#include "bitboard.h"
+#include "perft.h"
+#include "rules.h"
+#include "search.h"
+#include "eval.h"
+#include "uci.h"
+#include "batch.h"
+#include "pgn.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
-int main(){
+int main(int argc, char **argv){
+	init_bitboards();
+	init_zobrist();
+	init_eval();
+
+	// tchess perft [<depth> [fen]]: move generator benchmark and correctness check
+	if (argc > 1 && strcmp(argv[1], "perft") == 0) {
+		return perft_command(argc - 2, argv + 2);
+	}
+	// tchess search [-d depth] [-n nodes] [-m movetime_ms] [-c clock_ms] ... [fen]: best move in a position
+	if (argc > 1 && strcmp(argv[1], "search") == 0) {
+		return search_command(argc - 2, argv + 2);
+	}
+	// tchess batch [-t threads] <file>: legal moves, check and status of every FEN/EPD line of a file
+	if (argc > 1 && strcmp(argv[1], "batch") == 0) {
+		return batch_command(argc - 2, argv + 2);
+	}
+	// tchess pgn [-t threads] <file>: replay every game of a PGN file
+	if (argc > 1 && strcmp(argv[1], "pgn") == 0) {
+		return pgn_command(argc - 2, argv + 2);
+	}
+	// tchess uci: play through a chess GUI
+	if (argc > 1 && strcmp(argv[1], "uci") == 0) {
+		return uci_loop(false);
+	}
+
 	Position *pos = malloc(sizeof(Position));
 	MoveList *move_list = malloc(sizeof(MoveList));
 	
 	init_position(pos);
+	GameHistory history;
+	history_init(&history, pos);
 	while (1) {
 		print_board(pos);
-		char* input = malloc(6 * sizeof(char));
+		GameStatus game = status(pos, pos->side_to_move, repetition_count(&history));
+		if (game != ONGOING) {
+			static const char *results[] = { "", "Checkmate", "Stalemate", "Draw by the fifty-move rule",
+			                                 "Draw by threefold repetition", "Draw by insufficient material" };
+			printf("%s\n", results[game]);
+			break;
+		}
+		char input[6];
+		char uci[6];
 		generate_legal(pos, move_list);
 		for (int i = 0; i < move_list->count; i++) {
-					printf("%s%s ", square_to_string(move_list->list[i].from), square_to_string(move_list->list[i].to));
+			move_to_uci(move_list->list[i], uci);
+			printf("%s ", uci);
 		}
 		printf("\n");
 		printf("Enter your move (e.g., e2e4): ");
-		scanf("%5s", input);
-		if (strncmp(input, "q", 1) != 0 && strlen(input) < 4) {
+		if (scanf("%5s", input) != 1) break;
+		if (input[0] == 'q') break; // Quit if user inputs 'q'
+		if (strcmp(input, "uci") == 0) { // A GUI started us without arguments
+			history_free(&history);
+			free(pos);
+			free(move_list);
+			return uci_loop(true);
+		}
+		Move move = uci_to_move(pos, input);
+		if (move == MOVE_NONE) {
 			printf("Invalid input. Try again.\n");
 			continue;
 		}
-		if (input[0] == 'q') break; // Quit if user inputs 'q'
-		Move *move = parse_move(input);
-		for (int i = 0; i < move_list->count; i++) {
-			if (move->promotionPiece == '0') {
-			if (move_list->list[i].from == move->from && move_list->list[i].to == move->to) {
-				make_move(pos, &move_list->list[i]);
-				break;
-			} else if (i == move_list->count - 1) {
-				printf("Invalid move. Try again.\n");
-				continue;
-			}
-			} else {
-				if (move_list->list[i].from == move->from && move_list->list[i].to == move->to && move_list->list[i].promotionPiece == move->promotionPiece) {
-					make_move(pos, &move_list->list[i]);
-					break;
-				} else if (i == move_list->count - 1) {
-					printf("Invalid move. Try again.\n");
-					continue;
-				}
-			}
+		if (!is_pseudo_legal(pos, move) || !is_legal(pos, move)) {
+			printf("Invalid move. Try again.\n");
+			continue;
 		}
+		make_move(pos, move);
+		history_push(&history, pos);
 		system("clear"); // Clear the console (works on Unix-like systems)
 
 	}
+	history_free(&history);
+	return 0;
 }
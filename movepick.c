@@ -0,0 +1,136 @@
+#include "movepick.h"
+#include "generators.h"
+#include "eval.h"
+#include "see.h"
+
+// Hash and killer moves come from other nodes (a key collision, a sibling position): they are
+// checked on their own before being played, so they can be tried before any generation
+static inline bool fits(const Position *pos, Move m) {
+	return m != MOVE_NONE && is_pseudo_legal(pos, m) && is_legal(pos, m);
+}
+
+void picker_init(MovePicker *mp, const Position *pos, Move hash_move, const Move killers[2],
+                 const int *history) {
+	mp->pos = pos;
+	mp->history = history;
+	mp->hash_move = fits(pos, hash_move) ? hash_move : MOVE_NONE;
+	mp->killers[0] = killers ? killers[0] : MOVE_NONE;
+	mp->killers[1] = killers ? killers[1] : MOVE_NONE;
+	mp->stage = STAGE_HASH;
+	mp->moves.count = 0;
+	mp->index = 0;
+	mp->killer_index = 0;
+	mp->bad_captures.count = 0;
+	mp->bad_index = 0;
+	mp->captures_only = false;
+}
+
+void picker_init_captures(MovePicker *mp, const Position *pos) {
+	picker_init(mp, pos, MOVE_NONE, NULL, NULL);
+	mp->stage = STAGE_GEN_CAPTURES;
+	mp->captures_only = true;
+}
+
+static void score_captures(MovePicker *mp) {
+	const Position *pos = mp->pos;
+	for (int i = 0; i < mp->moves.count; i++) {
+		Move m = mp->moves.list[i];
+		Piece victim = pos->board[move_to(m)];
+		int value = move_flags(m) == FLAG_EN_PASSANT ? piece_value[PAWN] :
+		            victim == NO_PIECE ? 0 : piece_value[piece_type(victim)];
+		if (move_is_promotion(m)) value += piece_value[move_promotion_type(m)];
+		mp->scores[i] = 8 * value - piece_type(pos->board[move_from(m)]);
+	}
+}
+
+static void score_quiets(MovePicker *mp) {
+	for (int i = 0; i < mp->moves.count; i++) {
+		Move m = mp->moves.list[i];
+		mp->scores[i] = mp->history ? mp->history[move_from(m) * NUM_SQUARES + move_to(m)] : 0;
+	}
+}
+
+// Swap entries i and j of the list and their scores
+static inline void swap_moves(MovePicker *mp, int i, int j) {
+	Move m = mp->moves.list[i];
+	mp->moves.list[i] = mp->moves.list[j];
+	mp->moves.list[j] = m;
+	int s = mp->scores[i];
+	mp->scores[i] = mp->scores[j];
+	mp->scores[j] = s;
+}
+
+// Whether m was handed out already, ahead of the generated lists
+static inline bool played_early(const MovePicker *mp, Move m) {
+	return m == mp->hash_move || m == mp->killers[0] || m == mp->killers[1];
+}
+
+// Next move of the current list, best score first (selection sort, one step at a time)
+static Move pick_best(MovePicker *mp) {
+	while (mp->index < mp->moves.count) {
+		int best = mp->index;
+		for (int j = best + 1; j < mp->moves.count; j++) {
+			if (mp->scores[j] > mp->scores[best]) best = j;
+		}
+		swap_moves(mp, mp->index, best);
+		Move m = mp->moves.list[mp->index++];
+		if (!played_early(mp, m)) return m;
+	}
+	return MOVE_NONE;
+}
+
+Move picker_next(MovePicker *mp) {
+	Move m;
+	switch (mp->stage) {
+	case STAGE_HASH:
+		mp->stage = STAGE_GEN_CAPTURES;
+		if (mp->hash_move != MOVE_NONE) return mp->hash_move;
+		// fall through
+	case STAGE_GEN_CAPTURES:
+		generate_legal_captures(mp->pos, &mp->moves);
+		score_captures(mp);
+		mp->index = 0;
+		mp->stage = STAGE_CAPTURES;
+		// fall through
+	case STAGE_CAPTURES:
+		while ((m = pick_best(mp)) != MOVE_NONE) {
+			if (mp->captures_only && move_is_promotion(m) && move_promotion_type(m) != QUEEN) continue;
+			if (see_ge(mp->pos, m, 0)) return m;
+			if (!mp->captures_only) add_move(&mp->bad_captures, m);
+		}
+		if (mp->captures_only) {
+			mp->stage = STAGE_DONE;
+			break;
+		}
+		mp->stage = STAGE_KILLERS;
+		// fall through
+	case STAGE_KILLERS:
+		// A killer that doesn't fit here is dropped, so that the quiet stage doesn't skip it
+		while (mp->killer_index < 2) {
+			Move *killer = &mp->killers[mp->killer_index++];
+			if (*killer != mp->hash_move && !move_is_capture(*killer) && !move_is_promotion(*killer) &&
+			    fits(mp->pos, *killer))
+				return *killer;
+			*killer = MOVE_NONE;
+		}
+		mp->stage = STAGE_GEN_QUIETS;
+		// fall through
+	case STAGE_GEN_QUIETS:
+		generate_legal_quiets(mp->pos, &mp->moves);
+		score_quiets(mp);
+		mp->index = 0;
+		mp->stage = STAGE_QUIETS;
+		// fall through
+	case STAGE_QUIETS:
+		if ((m = pick_best(mp)) != MOVE_NONE) return m;
+		mp->stage = STAGE_BAD_CAPTURES;
+		// fall through
+	case STAGE_BAD_CAPTURES:
+		if (mp->bad_index < mp->bad_captures.count) return mp->bad_captures.list[mp->bad_index++];
+		mp->stage = STAGE_DONE;
+		// fall through
+	case STAGE_DONE:
+		break;
+	}
+	return MOVE_NONE;
+}
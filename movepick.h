@@ -0,0 +1,46 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include "tchess.h"
+
+// Hands out the legal moves of a position one at a time, best guesses first, generating each
+// group only once the previous one is used up: the hash move, captures and promotions by
+// most valuable victim / least valuable attacker, the two killer moves, the remaining quiet
+// moves by history score, and last the captures that lose material by SEE.
+// Most nodes cut off before the quiet moves are ever generated.
+// The hash move and the killers are checked one by one with is_legal, without a move list.
+typedef enum {
+	STAGE_HASH,
+	STAGE_GEN_CAPTURES,
+	STAGE_CAPTURES,
+	STAGE_KILLERS,
+	STAGE_GEN_QUIETS,
+	STAGE_QUIETS,
+	STAGE_BAD_CAPTURES,
+	STAGE_DONE
+} PickStage;
+
+typedef struct {
+	const Position *pos;
+	const int *history; // history scores of the side to move, indexed by from * NUM_SQUARES + to
+	Move hash_move;
+	Move killers[2];
+	PickStage stage;
+	MoveList moves;
+	int scores[256];
+	int index;
+	int killer_index;
+	MoveList bad_captures; // losing captures, put off until after the quiet moves
+	int bad_index;
+	bool captures_only;    // quiescence search: winning or even captures and queen promotions only
+} MovePicker;
+
+// killers may hold MOVE_NONE; history may be NULL
+void picker_init(MovePicker *mp, const Position *pos, Move hash_move, const Move killers[2],
+                 const int *history);
+// Quiescence search: the captures that don't lose material by SEE and the queen promotions,
+// in the same order as above, and nothing else
+void picker_init_captures(MovePicker *mp, const Position *pos);
+Move picker_next(MovePicker *mp); // MOVE_NONE once every legal move was returned
+
+#endif // MOVEPICK_H
@@ -0,0 +1,119 @@
+#include "pawns.h"
+#include "bitboard.h"
+#include "directions.h"
+#include <stdlib.h>
+
+// Bonuses and penalties by relative rank (0 = own first rank)
+static const int passed_mg[NUM_RANKS] = { 0, 5, 10, 20, 35, 60, 100, 0 };
+static const int passed_eg[NUM_RANKS] = { 0, 10, 20, 40, 70, 120, 200, 0 };
+#define DOUBLED_MG   10
+#define DOUBLED_EG   20
+#define ISOLATED_MG  10
+#define ISOLATED_EG  15
+#define BACKWARD_MG   8
+#define BACKWARD_EG  10
+#define SHELTER_NEAR 10 // own pawn one step in front of the king's rank, per file
+#define SHELTER_FAR   5 // two steps in front
+#define SHELTER_NONE 10 // no pawn at all on that file
+
+bool pawn_table_init(PawnTable *table) {
+	table->entries = calloc(PAWN_TABLE_ENTRIES, sizeof(PawnEntry));
+	table->mask = table->entries ? PAWN_TABLE_ENTRIES - 1 : 0;
+	return table->entries != NULL;
+}
+
+void pawn_table_free(PawnTable *table) {
+	free(table->entries);
+	table->entries = NULL;
+	table->mask = 0;
+}
+
+// Every square in front of the set, seen from color c
+static Bitboard fill_forward(Bitboard b, Color c) {
+	if (c == WHITE) {
+		b |= b >> 8;
+		b |= b >> 16;
+		b |= b >> 32;
+	} else {
+		b |= b << 8;
+		b |= b << 16;
+		b |= b << 32;
+	}
+	return b;
+}
+
+static inline Bitboard adjacent_files(Bitboard b) {
+	return shift_bb(b, E) | shift_bb(b, W);
+}
+
+static inline int relative_rank(Color c, Square sq) {
+	return c == WHITE ? rank_of(sq) : 7 - rank_of(sq);
+}
+
+static void evaluate_side(const Position *pos, Color c, PawnEntry *e, int *mg, int *eg) {
+	Bitboard ours = pos->pieces[make_piece(c, PAWN)];
+	Bitboard theirs = pos->pieces[make_piece(!c, PAWN)];
+	int up = c == WHITE ? N : S;
+	Bitboard their_attacks = shift_bb(theirs, c == WHITE ? SE : NE) | shift_bb(theirs, c == WHITE ? SW : NW);
+
+	Bitboard b = ours;
+	while (b) {
+		Square sq = pop_lsb(&b);
+		Bitboard file = FILE_A_BB << file_of(sq);
+		Bitboard front = fill_forward(shift_bb(sq_bb(sq), up), c);
+		// Neighbours level with or behind the pawn, which could come up to support it
+		Bitboard supporters = ours & adjacent_files(file) & ~fill_forward(shift_bb(RANK_BB(rank_of(sq)), up), c);
+		int rr = relative_rank(c, sq);
+
+		if (!(theirs & (front | adjacent_files(front)))) {
+			e->passed[c] |= sq_bb(sq);
+			*mg += passed_mg[rr];
+			*eg += passed_eg[rr];
+		}
+		if (ours & front) {
+			*mg -= DOUBLED_MG;
+			*eg -= DOUBLED_EG;
+		}
+		if (!(ours & adjacent_files(file))) {
+			*mg -= ISOLATED_MG;
+			*eg -= ISOLATED_EG;
+		} else if (!supporters && (their_attacks & shift_bb(sq_bb(sq), up))) {
+			// Its neighbours are all ahead of it and its next square is guarded
+			*mg -= BACKWARD_MG;
+			*eg -= BACKWARD_EG;
+		}
+	}
+
+	for (int f = 0; f < NUM_FILES; f++) {
+		if (!(ours & (FILE_A_BB << f))) e->semi_open[c] |= 1 << f;
+		// Shield of a king on its first rank on file f: the pawns on f and next to it
+		int shelter = 0;
+		for (int g = f - 1; g <= f + 1; g++) {
+			if (g < 0 || g >= NUM_FILES) continue;
+			Bitboard on_file = ours & (FILE_A_BB << g);
+			if (on_file & RANK_BB(c == WHITE ? 1 : 6)) shelter += SHELTER_NEAR;
+			else if (on_file & RANK_BB(c == WHITE ? 2 : 5)) shelter += SHELTER_FAR;
+			else if (!on_file) shelter -= SHELTER_NONE;
+		}
+		e->shelter[c][f] = (int8_t)shelter;
+	}
+}
+
+static void evaluate_pawns(const Position *pos, PawnEntry *e) {
+	int mg[2] = {0, 0};
+	int eg[2] = {0, 0};
+	e->key = pos->pawn_key;
+	e->valid = true;
+	e->passed[WHITE] = e->passed[BLACK] = 0;
+	e->semi_open[WHITE] = e->semi_open[BLACK] = 0;
+	evaluate_side(pos, WHITE, e, &mg[WHITE], &eg[WHITE]);
+	evaluate_side(pos, BLACK, e, &mg[BLACK], &eg[BLACK]);
+	e->score_mg = (int16_t)(mg[WHITE] - mg[BLACK]);
+	e->score_eg = (int16_t)(eg[WHITE] - eg[BLACK]);
+}
+
+const PawnEntry *pawn_probe(PawnTable *table, const Position *pos, PawnEntry *scratch) {
+	PawnEntry *e = table ? &table->entries[pos->pawn_key & table->mask] : scratch;
+	if (!table || !e->valid || e->key != pos->pawn_key) evaluate_pawns(pos, e);
+	return e;
+}
@@ -0,0 +1,31 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include "tchess.h"
+#include <stddef.h>
+
+// Pawn-structure terms, which only depend on the pawns and so are cached by pawn key
+typedef struct {
+	uint64_t key;
+	bool valid;
+	int16_t score_mg, score_eg;     // passed, isolated, doubled and backward pawns (white's view)
+	Bitboard passed[2];             // passed pawns of each color
+	int8_t shelter[2][NUM_FILES];   // pawn shield in front of a king castled on each file
+	uint8_t semi_open[2];           // files with no pawn of that color, one bit per file
+} PawnEntry;
+
+// One table per search thread, so no locking
+typedef struct {
+	PawnEntry *entries;
+	uint64_t mask; // number of entries - 1 (a power of two)
+} PawnTable;
+
+#define PAWN_TABLE_ENTRIES 8192
+
+bool pawn_table_init(PawnTable *table); // false if out of memory
+void pawn_table_free(PawnTable *table);
+
+// The entry for the pawns of pos, evaluated on a miss; with table NULL, 'scratch' is filled
+const PawnEntry *pawn_probe(PawnTable *table, const Position *pos, PawnEntry *scratch);
+
+#endif // PAWNS_H
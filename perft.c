@@ -0,0 +1,282 @@
+#include "perft.h"
+#include "generators.h"
+#include "threadpool.h"
+#include "timeman.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Well-known positions with verified node counts (chessprogramming.org "Perft Results",
+// plus the en passant / promotion / castling edge cases collected by Martin Sedlak)
+typedef struct {
+	const char *name;
+	const char *fen;
+	int depth;
+	uint64_t nodes;
+} PerftCase;
+
+static const PerftCase suite[] = {
+	{ "start position",         START_FEN, 5, 4865609ULL },
+	{ "kiwipete",               "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603ULL },
+	{ "position 3 (en passant)", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083ULL },
+	{ "position 4 (promotions)", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333ULL },
+	{ "position 5",             "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487ULL },
+	{ "position 6",             "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594ULL },
+	{ "ep discovered check",    "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467ULL },
+	{ "ep pinned on diagonal",  "8/5bk1/8/2Pp4/8/1K6/8/8 w - d6 0 1", 6, 824064ULL },
+	{ "ep pinned on rank",      "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133ULL },
+	{ "ep into check",          "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888ULL },
+	{ "castling rights",        "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206ULL },
+	{ "castling prevented",     "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476ULL },
+	{ "castle to give check",   "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072ULL },
+	{ "queenside castle check", "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711ULL },
+	{ "promote out of check",   "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001ULL },
+	{ "discovered check",       "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658ULL },
+	{ "promote to give check",  "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342ULL },
+	{ "underpromote to check",  "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683ULL },
+	{ "self stalemate",         "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217ULL },
+	{ "stalemate and checkmate", "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584ULL },
+	{ "double check",           "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527ULL },
+};
+
+bool perft_hash_init(PerftHash *hash, size_t mb) {
+	hash->entries = hash_alloc(mb, sizeof(HashEntry), &hash->mask);
+	return hash->entries != NULL;
+}
+
+void perft_hash_free(PerftHash *hash) {
+	free(hash->entries);
+	hash->entries = NULL;
+	hash->mask = 0;
+}
+
+// Different depths of the same position go to different slots
+static inline uint64_t perft_hash_key(uint64_t key, int depth) {
+	return key ^ ((uint64_t)depth * 0x9E3779B97F4A7C15ULL);
+}
+
+static bool perft_hash_probe(PerftHash *hash, uint64_t key, int depth, uint64_t *nodes) {
+	uint64_t k = perft_hash_key(key, depth);
+	uint64_t data;
+	if (!hash_entry_read(&hash->entries[k & hash->mask], k, &data) || (int)(data & 0xFF) != depth) return false;
+	*nodes = data >> 8;
+	return true;
+}
+
+static void perft_hash_store(PerftHash *hash, uint64_t key, int depth, uint64_t nodes) {
+	uint64_t k = perft_hash_key(key, depth);
+	hash_entry_write(&hash->entries[k & hash->mask], k, (nodes << 8) | (uint64_t)depth);
+}
+
+uint64_t perft(Position *pos, UndoStack *st, int depth, PerftHash *hash) {
+	if (depth == 0) return 1;
+
+	uint64_t nodes = 0;
+	if (hash && depth > 1 && perft_hash_probe(hash, pos->key, depth, &nodes)) return nodes;
+
+	if (depth == 1) return (uint64_t)count_legal(pos); // bulk counting at the leaves, no move list
+	MoveList ml;
+	generate_legal(pos, &ml);
+
+	for (int i = 0; i < ml.count; i++) {
+		push_move(pos, st, ml.list[i]);
+		nodes += perft(pos, st, depth - 1, hash);
+		pop_move(pos, st);
+	}
+	if (hash) perft_hash_store(hash, pos->key, depth, nodes);
+	return nodes;
+}
+
+// One subtree of a parallel perft: the position some plies below the root
+typedef struct {
+	Position pos;
+	int root;       // index of the root move it descends from
+	int depth;      // plies left below pos
+	uint64_t nodes;
+} PerftTask;
+
+typedef struct {
+	PerftTask *tasks;
+	size_t count;
+	size_t capacity;
+} PerftTaskList;
+
+// Collect every position 'plies' moves below pos as a task
+static bool collect_tasks(Position *pos, UndoStack *st, int plies, int depth, int root, PerftTaskList *list) {
+	if (plies == 0) {
+		if (list->count == list->capacity) {
+			size_t capacity = list->capacity ? 2 * list->capacity : 1024;
+			PerftTask *tasks = realloc(list->tasks, capacity * sizeof(PerftTask));
+			if (!tasks) return false;
+			list->tasks = tasks;
+			list->capacity = capacity;
+		}
+		list->tasks[list->count++] = (PerftTask){*pos, root, depth, 0};
+		return true;
+	}
+	MoveList ml;
+	generate_legal(pos, &ml);
+	for (int i = 0; i < ml.count; i++) {
+		push_move(pos, st, ml.list[i]);
+		bool ok = collect_tasks(pos, st, plies - 1, depth - 1, st->ply == 1 ? i : root, list);
+		pop_move(pos, st);
+		if (!ok) return false;
+	}
+	return true;
+}
+
+typedef struct {
+	PerftTask *tasks;
+	PerftHash *hash;
+} PerftJob;
+
+// Each worker walks its subtrees on its own copy of the position, with its own undo stack
+static void run_perft_task(void *ctx, size_t index, int worker) {
+	(void)worker;
+	PerftJob *job = ctx;
+	PerftTask *task = &job->tasks[index];
+	UndoStack st;
+	st.ply = 0;
+	task->nodes = perft(&task->pos, &st, task->depth, job->hash);
+}
+
+uint64_t perft_parallel(const Position *root, int depth, int threads, int split_depth,
+                        uint64_t *root_nodes, PerftHash *hash) {
+	Position pos = *root;
+	UndoStack st;
+	st.ply = 0;
+	MoveList ml;
+	generate_legal(&pos, &ml);
+	if (root_nodes) memset(root_nodes, 0, ml.count * sizeof(uint64_t));
+	if (depth == 1 && root_nodes) {
+		for (int i = 0; i < ml.count; i++) root_nodes[i] = 1;
+	}
+	if (depth <= 1) return depth == 0 ? 1 : (uint64_t)ml.count;
+	if (ml.count == 0) return 0; // mate or stalemate: no leaves below
+
+	// Split at least one ply below the root, and never at or below the leaves
+	if (split_depth < 1) split_depth = 1;
+	if (split_depth > depth - 1) split_depth = depth - 1;
+
+	PerftTaskList list = {NULL, 0, 0};
+	uint64_t total = 0;
+	if (!collect_tasks(&pos, &st, split_depth, depth, 0, &list)) {
+		// Out of memory for the task list: count serially instead
+		free(list.tasks);
+		for (int i = 0; i < ml.count; i++) {
+			push_move(&pos, &st, ml.list[i]);
+			uint64_t nodes = perft(&pos, &st, depth - 1, hash);
+			pop_move(&pos, &st);
+			if (root_nodes) root_nodes[i] = nodes;
+			total += nodes;
+		}
+		return total;
+	}
+
+	PerftJob job = {list.tasks, hash};
+	pool_run(threads, list.count, run_perft_task, &job);
+
+	for (size_t i = 0; i < list.count; i++) {
+		if (root_nodes) root_nodes[list.tasks[i].root] += list.tasks[i].nodes;
+		total += list.tasks[i].nodes;
+	}
+	free(list.tasks);
+	return total;
+}
+
+uint64_t perft_divide(Position *pos, int depth, int threads, int split_depth, PerftHash *hash) {
+	uint64_t root_nodes[256];
+	MoveList ml;
+	generate_legal(pos, &ml);
+
+	uint64_t total = perft_parallel(pos, depth, threads, split_depth, root_nodes, hash);
+	char uci[6];
+	for (int i = 0; i < ml.count; i++) {
+		move_to_uci(ml.list[i], uci);
+		printf("%s: %llu\n", uci, (unsigned long long)root_nodes[i]);
+	}
+	return total;
+}
+
+int perft_suite(int threads, int split_depth, PerftHash *hash) {
+	int failures = 0;
+	uint64_t total_nodes = 0;
+	double total_time = 0;
+
+	for (size_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++) {
+		const PerftCase *c = &suite[i];
+		Position pos;
+		if (!parse_fen(c->fen, &pos)) {
+			printf("%-24s bad FEN\n", c->name);
+			failures++;
+			continue;
+		}
+		double start = tm_now();
+		uint64_t nodes = perft_parallel(&pos, c->depth, threads, split_depth, NULL, hash);
+		double elapsed = tm_now() - start;
+		bool ok = nodes == c->nodes;
+		printf("%-24s depth %d %12llu nodes %8.3f s  %s\n", c->name, c->depth,
+		       (unsigned long long)nodes, elapsed, ok ? "ok" : "FAILED");
+		if (!ok) {
+			printf("    expected %llu\n", (unsigned long long)c->nodes);
+			failures++;
+		}
+		total_nodes += nodes;
+		total_time += elapsed;
+	}
+	printf("\nThreads: %d\nNodes: %llu\nTime: %.3f s\nNPS: %.0f\n", threads, (unsigned long long)total_nodes,
+	       total_time, total_time > 0 ? total_nodes / total_time : 0.0);
+	printf("%s\n", failures ? "SUITE FAILED" : "All positions passed");
+	return failures;
+}
+
+// Suite or single position, once the options are parsed
+static int perft_run(int argc, char **argv, int threads, int split_depth, PerftHash *hash) {
+	if (argc < 1) return perft_suite(threads, split_depth, hash) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	int depth = atoi(argv[0]);
+	if (depth < 1) {
+		fprintf(stderr, "usage: tchess perft [-t threads] [-s split_depth] [-H hash_mb] [<depth> [fen]]\n");
+		return EXIT_FAILURE;
+	}
+	Position pos;
+	if (!parse_fen_args(argc - 1, argv + 1, &pos)) return EXIT_FAILURE;
+
+	double start = tm_now();
+	uint64_t nodes = perft_divide(&pos, depth, threads, split_depth, hash);
+	double elapsed = tm_now() - start;
+	printf("\nThreads: %d\nNodes: %llu\nTime: %.3f s\nNPS: %.0f\n", threads, (unsigned long long)nodes,
+	       elapsed, elapsed > 0 ? nodes / elapsed : 0.0);
+	return EXIT_SUCCESS;
+}
+
+int perft_command(int argc, char **argv) {
+	int threads = pool_default_threads();
+	int split_depth = 2;
+	int hash_mb = 0;
+
+	// Options first: -t <threads>, -s <split depth>, -H <hash size in MB>
+	while (argc >= 2 && argv[0][0] == '-') {
+		if (strcmp(argv[0], "-t") == 0) threads = atoi(argv[1]);
+		else if (strcmp(argv[0], "-s") == 0) split_depth = atoi(argv[1]);
+		else if (strcmp(argv[0], "-H") == 0) hash_mb = atoi(argv[1]);
+		else break;
+		argc -= 2;
+		argv += 2;
+	}
+	if (threads < 1) threads = 1;
+
+	PerftHash table;
+	PerftHash *hash = NULL;
+	if (hash_mb > 0) {
+		if (!perft_hash_init(&table, (size_t)hash_mb)) {
+			fprintf(stderr, "Cannot allocate %d MB of hash\n", hash_mb);
+			return EXIT_FAILURE;
+		}
+		hash = &table;
+	}
+
+	int result = perft_run(argc, argv, threads, split_depth, hash);
+	if (hash) perft_hash_free(hash);
+	return result;
+}
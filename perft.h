@@ -0,0 +1,33 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "tchess.h"
+#include "hashtable.h"
+#include <stddef.h>
+
+// Subtree counts cached by (Zobrist key, depth), shared by all perft threads.
+// Entry data: node count << 8 | depth.
+typedef struct {
+	HashEntry *entries;
+	uint64_t mask; // number of entries - 1 (a power of two)
+} PerftHash;
+
+bool perft_hash_init(PerftHash *hash, size_t mb); // Allocate about mb megabytes; false if out of memory
+void perft_hash_free(PerftHash *hash);
+
+// Count the leaf nodes of the legal move tree, depth plies deep (hash may be NULL)
+uint64_t perft(Position *pos, UndoStack *st, int depth, PerftHash *hash);
+// Multithreaded perft: the tree is split split_depth plies below the root and the subtrees
+// are shared among 'threads' workers. root_nodes (may be NULL) receives the count below each
+// root move, in generate_legal order.
+uint64_t perft_parallel(const Position *pos, int depth, int threads, int split_depth,
+                        uint64_t *root_nodes, PerftHash *hash);
+// Same, printing the count below each root move
+uint64_t perft_divide(Position *pos, int depth, int threads, int split_depth, PerftHash *hash);
+// Run the built-in positions against their known node counts; returns the number of failures
+int perft_suite(int threads, int split_depth, PerftHash *hash);
+
+// Command line entry point: tchess perft [-t threads] [-s split_depth] [-H hash_mb] [<depth> [fen]]
+int perft_command(int argc, char **argv);
+
+#endif // PERFT_H
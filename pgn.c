@@ -0,0 +1,320 @@
+#include "pgn.h"
+#include "bitboard.h"
+#include "chunks.h"
+#include "directions.h"
+#include "generators.h"
+#include "rules.h"
+#include "threadpool.h"
+#include "timeman.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOKEN_MAX 16 // longest illegal move echoed back
+
+// -- SAN --
+
+static Move castle(const Position *pos, bool king_side) {
+	Square from = pos->side_to_move == WHITE ? E1 : E8;
+	Move m = king_side ? new_move(from, from + 2, FLAG_KING_CASTLE) : new_move(from, from - 2, FLAG_QUEEN_CASTLE);
+	return is_pseudo_legal(pos, m) && is_legal(pos, m) ? m : MOVE_NONE;
+}
+
+Move san_to_move(const Position *pos, const char *san, size_t len) {
+	while (len > 0 && strchr("+#!?", san[len - 1])) len--;
+	if (len == 0) return MOVE_NONE;
+	if ((len == 3 && (!strncmp(san, "O-O", 3) || !strncmp(san, "0-0", 3))) ||
+	    (len == 5 && (!strncmp(san, "O-O-O", 5) || !strncmp(san, "0-0-0", 5))))
+		return castle(pos, len == 3);
+
+	// [piece] [from file] [from rank] [x] to [=promotion]
+	static const char piece_letters[] = "NBRQK";
+	PieceType type = PAWN;
+	size_t i = 0;
+	const char *letter = strchr(piece_letters, san[0]);
+	if (san[0] && letter) {
+		type = (PieceType)(KNIGHT + (letter - piece_letters));
+		i = 1;
+	}
+	PieceType promotion = NO_PIECE_TYPE;
+	if (type == PAWN && len >= 3 && san[len - 1] && (letter = strchr(piece_letters, san[len - 1])) && *letter != 'K') {
+		promotion = (PieceType)(KNIGHT + (letter - piece_letters));
+		len -= san[len - 2] == '=' ? 2 : 1;
+	}
+	if (len < i + 2) return MOVE_NONE;
+	char to_file = san[len - 2], to_rank = san[len - 1];
+	if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') return MOVE_NONE;
+	Square to = SQ(to_file - 'a', to_rank - '1');
+	len -= 2;
+
+	int from_file = -1, from_rank = -1;
+	bool capture = false;
+	for (; i < len; i++) {
+		if (san[i] == 'x') capture = true;
+		else if (san[i] >= 'a' && san[i] <= 'h') from_file = san[i] - 'a';
+		else if (san[i] >= '1' && san[i] <= '8') from_rank = san[i] - '1';
+		else if (san[i] != '-') return MOVE_NONE; // '-' of long algebraic "e2-e4"
+	}
+
+	Color us = pos->side_to_move;
+	Piece target = pos->board[to];
+	if (target != NO_PIECE && (piece_color(target) == us || piece_type(target) == KING)) return MOVE_NONE;
+	Bitboard from_mask = ~0ULL;
+	if (from_file >= 0) from_mask &= FILE_A_BB << from_file;
+	if (from_rank >= 0) from_mask &= RANK_BB(from_rank);
+
+	Bitboard ours = pos->pieces[make_piece(us, type)];
+	Bitboard candidates = 0;
+	int flags = target != NO_PIECE ? FLAG_CAPTURE : FLAG_QUIET;
+	switch (type) {
+	case PAWN: {
+		int behind = us == WHITE ? S : N; // one step back towards the pawn's start
+		// No pawn ever reaches its own back rank: nothing behind it to look at
+		if (rank_of(to) == (us == WHITE ? 0 : 7)) return MOVE_NONE;
+		bool last_rank = rank_of(to) == (us == WHITE ? 7 : 0);
+		if (last_rank != (promotion != NO_PIECE_TYPE)) return MOVE_NONE;
+		if (from_file >= 0 && from_file != file_of(to)) {
+			candidates = pawn_attacks[!us][to] & ours & from_mask;
+			if (target == NO_PIECE) {
+				if (to != pos->en_passant_target) return MOVE_NONE;
+				flags = FLAG_EN_PASSANT;
+			}
+		} else {
+			if (capture || target != NO_PIECE) return MOVE_NONE;
+			Square one = to + behind;
+			if (pos->board[one] == make_piece(us, PAWN)) {
+				candidates = 1ULL << one;
+			} else if (pos->board[one] == NO_PIECE && rank_of(to) == (us == WHITE ? 3 : 4) &&
+			           pos->board[one + behind] == make_piece(us, PAWN)) {
+				candidates = 1ULL << (one + behind);
+				flags = FLAG_DOUBLE_PUSH;
+			}
+		}
+		if (last_rank) flags = (target != NO_PIECE ? FLAG_PROMOTION_CAPTURE : FLAG_PROMOTION) + (promotion - KNIGHT);
+		break;
+	}
+	case KNIGHT: candidates = knight_attacks[to]; break;
+	case BISHOP: candidates = bishop_attacks(to, pos->occupied); break;
+	case ROOK:   candidates = rook_attacks(to, pos->occupied); break;
+	case QUEEN:  candidates = queen_attacks(to, pos->occupied); break;
+	case KING:   candidates = king_attacks[to]; break;
+	default:     break;
+	}
+	// Pawns were checked above; for the pieces, an 'x' must match what is on the target
+	if (type != PAWN && capture != (target != NO_PIECE)) return MOVE_NONE;
+	candidates &= ours & from_mask;
+
+	// Usually a single candidate; with more, the SAN is only valid if exactly one is legal.
+	// Each candidate reaches the target by construction, so only the king's safety is left.
+	Move found = MOVE_NONE;
+	while (candidates) {
+		Move m = new_move(pop_lsb(&candidates), to, flags);
+		if (!is_legal(pos, m)) continue;
+		if (found != MOVE_NONE) return MOVE_NONE; // ambiguous
+		found = m;
+	}
+	return found;
+}
+
+// -- Replay --
+
+enum { GAMES, PLIES, ERRORS }; // chunk counters
+
+typedef struct {
+	Position pos;
+	GameHistory history;
+	int plies;
+	bool started;           // a tag or a move was seen
+	bool in_movetext;       // a move was seen: the next tag starts another game
+	bool failed;            // an illegal move: the rest of the movetext is skipped
+	char bad[TOKEN_MAX];    // the illegal move
+} Game;
+
+static void start_game(Game *g) {
+	init_position(&g->pos);
+	history_reset(&g->history, &g->pos);
+	g->plies = 0;
+	g->started = true;
+	g->in_movetext = false;
+	g->failed = false;
+}
+
+static void fail(Game *g, const char *token, size_t len) {
+	if (len >= sizeof(g->bad)) len = sizeof(g->bad) - 1;
+	memcpy(g->bad, token, len);
+	g->bad[len] = '\0';
+	g->failed = true;
+}
+
+static void finish_game(Chunk *c, Game *g, const char *result) {
+	char line[64];
+	int n;
+	if (g->failed) {
+		n = snprintf(line, sizeof(line), "%s %d illegal %s\n", result, g->plies, g->bad);
+		c->counts[ERRORS]++;
+	} else {
+		Color us = g->pos.side_to_move;
+		n = snprintf(line, sizeof(line), "%s %d %s\n", result, g->plies,
+		             status_name(status(&g->pos, us, repetition_count(&g->history))));
+	}
+	chunk_append(c, line, (size_t)n);
+	c->counts[GAMES]++;
+	c->counts[PLIES] += (size_t)g->plies;
+	g->started = false;
+}
+
+// A tag pair line, [Name "value"]; only a FEN tag matters. Returns the end of the line.
+static const char *read_tag(Game *g, const char *p, const char *end) {
+	const char *eol = memchr(p, '\n', (size_t)(end - p));
+	if (!eol) eol = end;
+	if (eol - p > 6 && strncmp(p, "[FEN \"", 6) == 0) {
+		const char *value = p + 6;
+		const char *quote = memchr(value, '"', (size_t)(eol - value));
+		char fen[FEN_MAX];
+		size_t len = quote ? (size_t)(quote - value) : 0;
+		if (!quote || len >= sizeof(fen)) {
+			fail(g, "FEN", 3);
+			return eol;
+		}
+		memcpy(fen, value, len);
+		fen[len] = '\0';
+		if (parse_fen(fen, &g->pos)) history_reset(&g->history, &g->pos);
+		else fail(g, "FEN", 3);
+	}
+	return eol;
+}
+
+static bool is_result(const char *token, size_t len) {
+	return (len == 3 && (!strncmp(token, "1-0", 3) || !strncmp(token, "0-1", 3))) ||
+	       (len == 7 && !strncmp(token, "1/2-1/2", 7)) || (len == 1 && token[0] == '*');
+}
+
+static void play_token(Chunk *c, Game *g, const char *token, size_t len) {
+	if (is_result(token, len)) {
+		char result[8];
+		memcpy(result, token, len);
+		result[len] = '\0';
+		if (!g->started) start_game(g);
+		finish_game(c, g, result);
+		return;
+	}
+	if (token[0] == '$') return; // numeric annotation glyph
+	// Move number, "12." or "12...", possibly glued to the move
+	size_t i = 0;
+	while (i < len && token[i] >= '0' && token[i] <= '9') i++;
+	if (i < len && token[i] == '.') {
+		while (i < len && token[i] == '.') i++;
+		token += i;
+		len -= i;
+	}
+	if (len == 0) return;
+
+	if (!g->started) start_game(g);
+	g->in_movetext = true;
+	if (g->failed) return;
+	Move m = san_to_move(&g->pos, token, len);
+	if (m == MOVE_NONE) {
+		fail(g, token, len);
+		return;
+	}
+	make_move(&g->pos, m);
+	history_push(&g->history, &g->pos);
+	g->plies++;
+}
+
+// Skip a comment or a (possibly nested) variation starting at p; returns what follows it
+static const char *skip_group(const char *p, const char *end) {
+	int depth = 0;
+	for (; p < end; p++) {
+		if (*p == '{') {
+			const char *close = memchr(p, '}', (size_t)(end - p));
+			if (!close) return end;
+			p = close;
+			if (depth == 0) return p + 1;
+		} else if (*p == '(') {
+			depth++;
+		} else if (*p == ')' && --depth == 0) {
+			return p + 1;
+		}
+	}
+	return end;
+}
+
+static void replay_games(Chunk *c) {
+	Game g;
+	memset(&g, 0, sizeof(g));
+	const char *p = c->begin, *end = c->end;
+	bool line_start = true;
+	while (p < end) {
+		char ch = *p;
+		if (ch == '\n') {
+			line_start = true;
+			p++;
+			continue;
+		}
+		if (line_start && ch == '[') {
+			if (g.started && g.in_movetext) finish_game(c, &g, "*"); // no result token
+			if (!g.started) start_game(&g);
+			p = read_tag(&g, p, end);
+			continue;
+		}
+		if (line_start && ch == '%') { // escaped line
+			const char *eol = memchr(p, '\n', (size_t)(end - p));
+			p = eol ? eol : end;
+			continue;
+		}
+		line_start = false;
+		if (ch == ' ' || ch == '\t' || ch == '\r') {
+			p++;
+		} else if (ch == '{' || ch == '(') {
+			p = skip_group(p, end);
+		} else if (ch == ';') {
+			const char *eol = memchr(p, '\n', (size_t)(end - p));
+			p = eol ? eol : end;
+		} else {
+			const char *token = p;
+			while (p < end && !strchr(" \t\r\n{}();[]", *p)) p++;
+			if (p == token) p++; // a stray delimiter
+			else play_token(c, &g, token, (size_t)(p - token));
+		}
+	}
+	if (g.started) finish_game(c, &g, "*");
+	history_free(&g.history);
+}
+
+// Start of the first game after p ("[Event" at the start of a line), or end
+static const char *next_game(const char *p, const char *end) {
+	while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+		p++;
+		if (end - p >= 6 && strncmp(p, "[Event", 6) == 0) return p;
+	}
+	return end;
+}
+
+int pgn_command(int argc, char **argv) {
+	int threads = pool_default_threads();
+
+	// Options first: -t <threads>
+	while (argc >= 2 && argv[0][0] == '-') {
+		if (strcmp(argv[0], "-t") == 0) threads = atoi(argv[1]);
+		else break;
+		argc -= 2;
+		argv += 2;
+	}
+	if (threads < 1) threads = 1;
+	if (argc < 1) {
+		fprintf(stderr, "Usage: tchess pgn [-t threads] <file>\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t totals[CHUNK_COUNTERS] = { 0 };
+	double start = tm_now();
+	int result = chunks_run_file(argv[0], threads, next_game, replay_games, totals);
+	if (result != EXIT_SUCCESS) return result;
+	double elapsed = tm_now() - start;
+	size_t games = totals[GAMES], plies = totals[PLIES];
+	fprintf(stderr, "%zu games (%zu with an illegal move), %zu plies in %.3f s: %.0f games/s, %.0f plies/s\n",
+	        games, totals[ERRORS], plies, elapsed, elapsed > 0 ? games / elapsed : 0.0,
+	        elapsed > 0 ? plies / elapsed : 0.0);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,17 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include "tchess.h"
+#include <stddef.h>
+
+// Decode a move in Standard Algebraic Notation (len characters, check marks and annotation
+// suffixes allowed) from the candidates that attack the target square, without generating
+// the move list. MOVE_NONE if it is malformed, illegal or ambiguous.
+Move san_to_move(const Position *pos, const char *san, size_t len);
+
+// Command line entry point: tchess pgn [-t threads] <file>
+// Replays every game of a PGN file and prints one line per game, in file order:
+// "<result> <plies> <status of the final position>", or "<result> <plies> illegal <move>".
+int pgn_command(int argc, char **argv);
+
+#endif // PGN_H
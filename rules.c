@@ -1,102 +1,47 @@
 #include "rules.h"
 #include "tchess.h"
 #include "generators.h"
+#include "bitboard.h"
 #include <stdlib.h>
 
 // Check control
 bool is_in_check(const Position* pos, Color side) {
 	Square king_sq = find_king(pos, side);
-	return is_square_attacked(pos, king_sq, side);
+	return is_square_attacked(pos, king_sq, !side);
 }
 
-static Color bishop_square_color(Square sq) {
-	int file = sq % 8;
-	int rank = sq / 8;
-	return (file + rank) % 2 == 0 ? WHITE : BLACK;
-}
-
-// Insufficient material detection
+// Insufficient material detection, from the piece bitboards (no scan, no allocation)
 static bool insufficient_material(const Position* pos) {
-	int white_material = 0;
-	int black_material = 0;
-	int white_bishops = 0;
-	Color* white_bishop_colors = malloc(8 * sizeof(Color));
-	int black_bishops = 0;
-	Color* black_bishop_colors = malloc(8 * sizeof(Color));
-	int white_knights = 0;
-	int black_knights = 0;
-
-	for (Square sq = A1; sq <= H8; sq++) {
-		Piece piece = pos->board[sq];
-		if (piece == NO_PIECE) continue;
-
-		Color color = piece_color(piece);
-		PieceType type = piece_type(piece);
-
-		if (type == PAWN || type == ROOK || type == QUEEN) {
-			return false; // Sufficient material
-		}
-
-		if (color == WHITE) {
-			if (type == BISHOP){
-				Color color = bishop_square_color(sq);
-				white_bishop_colors[white_bishops] = color;
-				white_bishops++;
-			}
-			else if (type == KNIGHT){
-				Color color = bishop_square_color(sq);
-				black_bishop_colors[black_bishops] = color;
-				black_bishops++;
-			}
-			else if (type == KING) continue;
-			white_material++;
-		} else {
-			if (type == BISHOP) black_bishops++;
-			else if (type == KNIGHT) black_knights++;
-			else if (type == KING) continue;
-			black_material++;
-		}
+	const Bitboard* pc = pos->pieces;
+	if (pc[WHITE_PAWN] | pc[BLACK_PAWN] | pc[WHITE_ROOK] | pc[BLACK_ROOK] | pc[WHITE_QUEEN] | pc[BLACK_QUEEN]) {
+		return false; // Sufficient material
 	}
+	int white_knights = popcount(pc[WHITE_KNIGHT]);
+	int black_knights = popcount(pc[BLACK_KNIGHT]);
+	Bitboard bishops = pc[WHITE_BISHOP] | pc[BLACK_BISHOP];
+	int white_material = white_knights + popcount(pc[WHITE_BISHOP]);
+	int black_material = black_knights + popcount(pc[BLACK_BISHOP]);
 
-	if (white_material < 2 && black_material == 0) {
+	if (white_material + black_material == 0) {
 		return true; // King vs King
 	}
-	if (white_material < 2 && black_material == 1 && black_knights == 1) {
-		return true; // King vs King and Knight
+	if (white_material + black_material == 1) {
+		return true; // King vs King and Knight, King vs King and Bishop
 	}
-	if (black_material < 2 && white_material == 1 && white_knights == 1) {
-		return true; 
-	}
-	if (white_material < 2 && black_material == 1 && black_bishops == 1) {
-		return true; // King vs King and Bishop
-	}
-	if (black_material < 2 && white_material == 1 && white_bishops == 1) {
-		return true; 
-	}
-	if (white_material < 2 && black_material == 2 && black_knights == 2) {
+	if ((white_material == 0 && black_knights == 2 && black_material == 2) ||
+		(black_material == 0 && white_knights == 2 && white_material == 2)) {
 		return true; // King vs King and two knights
 	}
-	if (black_material < 2 && white_material == 2 && white_knights == 2) {
-		return true; 
-	}
-	if (white_material <= 2 && black_bishops >= 2) {
-		for (int i = 1; i < black_bishops; i++) {
-			if (black_bishop_colors[i] != black_bishop_colors[0]) {
-				return false;
-			}
-		}
-		return true; // King vs King and two bishops on same color
+	if (white_knights + black_knights == 0 &&
+		(!(bishops & DARK_SQUARES_BB) || !(bishops & ~DARK_SQUARES_BB))) {
+		return true; // Only bishops, all on squares of the same color
 	}
 
 	return false; // Sufficient material
-
 }
 
 GameStatus status(const Position* pos, Color side, int repetition_count){
-	MoveList* ml;
-	generate_legal(pos, ml);
-
-	if (ml->count == 0) {
+	if (!has_any_legal_move(pos)) {
 		if (is_in_check(pos, side)) {
 			return CHECKMATE; 
 		} else {
@@ -107,7 +52,7 @@ GameStatus status(const Position* pos, Color side, int repetition_count){
 		if (repetition_count >= 3) {
 			return DRAW_REP;
 		}
-		if (pos->halfmove_clock >= 50) {
+		if (pos->halfmove_clock >= 100) { // 50 moves by each side
 			return DRAW_50;
 		}
 		if (insufficient_material(pos)){
@@ -118,3 +63,71 @@ GameStatus status(const Position* pos, Color side, int repetition_count){
 
 }
 
+const char* status_name(GameStatus s) {
+	static const char *names[] = { "ongoing", "checkmate", "stalemate", "fifty-move", "repetition",
+	                               "insufficient-material" };
+	return names[s];
+}
+
+// -- GAME HISTORY --
+
+bool history_init(GameHistory* h, const Position* pos) {
+	h->count = 0;
+	h->capacity = 256;
+	h->keys = malloc(h->capacity * sizeof(uint64_t));
+	h->halfmove_clocks = malloc(h->capacity * sizeof(int));
+	if (!h->keys || !h->halfmove_clocks) {
+		history_free(h);
+		return false;
+	}
+	return history_push(h, pos);
+}
+
+bool history_reset(GameHistory* h, const Position* pos) {
+	if (!h->keys) return history_init(h, pos);
+	h->count = 0;
+	return history_push(h, pos);
+}
+
+bool history_push(GameHistory* h, const Position* pos) {
+	if (h->count == h->capacity) {
+		int capacity = 2 * h->capacity;
+		uint64_t* keys = realloc(h->keys, capacity * sizeof(uint64_t));
+		if (!keys) return false;
+		h->keys = keys;
+		int* clocks = realloc(h->halfmove_clocks, capacity * sizeof(int));
+		if (!clocks) return false;
+		h->halfmove_clocks = clocks;
+		h->capacity = capacity;
+	}
+	h->keys[h->count] = pos->key;
+	h->halfmove_clocks[h->count] = pos->halfmove_clock;
+	h->count++;
+	return true;
+}
+
+void history_pop(GameHistory* h) {
+	if (h->count > 0) h->count--;
+}
+
+void history_free(GameHistory* h) {
+	free(h->keys);
+	free(h->halfmove_clocks);
+	h->keys = NULL;
+	h->halfmove_clocks = NULL;
+	h->count = h->capacity = 0;
+}
+
+// A position can only repeat within the halfmove clock window (no capture or pawn move since),
+// and only with the same side to move, hence every second entry
+int repetition_count(const GameHistory* h) {
+	if (h->count == 0) return 0;
+	int last = h->count - 1;
+	int window = h->halfmove_clocks[last];
+	int oldest = last - window < 0 ? 0 : last - window;
+	int count = 1;
+	for (int i = last - 2; i >= oldest; i -= 2) {
+		if (h->keys[i] == h->keys[last]) count++;
+	}
+	return count;
+}
@@ -4,7 +4,7 @@
  * 2. Checkmate;
  * 3. Stalemate;
  * 4. Fifty-move rule;
- * 5. Threefold repetition;
+ * 5. Threefold repetition; DONE (GameHistory)
  * 6. Insufficient material.
  */	
 
@@ -14,7 +14,23 @@
 
 typedef enum GameStatus { ONGOING, CHECKMATE, STALEMATE, DRAW_50, DRAW_REP, DRAW_INSUFF } GameStatus;
 
+// Keys and halfmove clocks of every position of a game, oldest first
+typedef struct {
+	uint64_t *keys;
+	int *halfmove_clocks;
+	int count;
+	int capacity;
+} GameHistory;
+
 bool is_in_check(const Position* board, Color side);
 GameStatus status(const Position* pos, Color side, int repetition_count);
+const char* status_name(GameStatus s); // e.g. "checkmate", "fifty-move"
+
+bool history_init(GameHistory* h, const Position* pos); // Start a history at pos
+bool history_reset(GameHistory* h, const Position* pos); // Start over at pos, keeping the memory
+bool history_push(GameHistory* h, const Position* pos); // Record pos, reached by a move (amortized O(1))
+void history_pop(GameHistory* h);                       // Forget the last position (move taken back)
+void history_free(GameHistory* h);
+int repetition_count(const GameHistory* h);             // Occurrences of the last position, itself included
 
 #endif // RULES_H
@@ -0,0 +1,408 @@
+#define _POSIX_C_SOURCE 200809L // flockfile
+#include "search.h"
+#include "generators.h"
+#include "eval.h"
+#include "tt.h"
+#include "movepick.h"
+#include "threadpool.h"
+#include "timeman.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_INTERVAL 1024 // nodes between two looks at the clock and the stop request
+
+typedef struct Searcher Searcher;
+
+// What all the threads of one search share
+typedef struct {
+	const GameHistory *history;
+	TransTable *tt;             // may be NULL
+	SearchLimits limits;
+	TimeManager tm;
+	atomic_bool stop;           // set by the main thread, read by everyone
+	Searcher *threads;
+	int num_threads;
+} SearchShared;
+
+// State of one search thread: its own copy of the position, the line being searched and
+// its move ordering tables. Thread 0 is the main thread, the others are helpers.
+struct Searcher {
+	SearchShared *shared;
+	int id;
+	Position pos;
+	UndoStack st;
+	_Atomic uint64_t nodes;                  // written by this thread only
+	int history[2][NUM_SQUARES][NUM_SQUARES]; // quiet moves that caused cutoffs, by side/from/to
+	Move killers[MAX_SEARCH_PLY][2];         // the last two quiet moves that cut off at each ply
+	PawnTable pawns;                         // pawn-structure cache, empty if it couldn't be allocated
+	Move pv[MAX_SEARCH_PLY][MAX_SEARCH_PLY]; // triangular PV table: pv[ply] is the line from ply on
+	int pv_length[MAX_SEARCH_PLY];
+	SearchResult result;                     // last completed iteration
+};
+
+static uint64_t total_nodes(const SearchShared *sh) {
+	uint64_t n = 0;
+	for (int i = 0; i < sh->num_threads; i++) {
+		n += atomic_load_explicit(&sh->threads[i].nodes, memory_order_relaxed);
+	}
+	return n;
+}
+
+// No limit but a stop applies while searching infinitely or pondering
+static inline bool unlimited(const SearchLimits *l) {
+	return l->infinite || (l->ponder && atomic_load_explicit(l->ponder, memory_order_relaxed));
+}
+
+// Only the main thread looks at the limits, every CHECK_INTERVAL of its nodes
+static void check_limits(Searcher *s) {
+	SearchShared *sh = s->shared;
+	uint64_t nodes = atomic_load_explicit(&s->nodes, memory_order_relaxed);
+	if (s->id != 0 || nodes % CHECK_INTERVAL != 0) return;
+	const SearchLimits *l = &sh->limits;
+	// A depth already reached only matters after a ponderhit: the iteration under way is extra
+	if ((l->stop && atomic_load_explicit(l->stop, memory_order_relaxed)) ||
+	    (!unlimited(l) && l->nodes && total_nodes(sh) >= l->nodes) ||
+	    (!unlimited(l) && l->depth > 0 && s->result.depth >= l->depth) ||
+	    (!unlimited(l) && tm_hard_expired(&sh->tm)))
+		atomic_store_explicit(&sh->stop, true, memory_order_relaxed);
+}
+
+static inline bool stopped(const Searcher *s) {
+	return atomic_load_explicit(&s->shared->stop, memory_order_relaxed);
+}
+
+// Key of the position 'back' plies before the current one (ply plies below the root)
+static uint64_t key_back(const Searcher *s, int ply, int back) {
+	if (back <= ply) return s->st.undo[ply - back].key;
+	const GameHistory *h = s->shared->history;
+	int i = h->count - 1 - (back - ply);
+	return i >= 0 ? h->keys[i] : 0;
+}
+
+// Fifty-move rule, or a position already seen (once is enough inside the search: if it was
+// good to repeat it once it will be good to repeat it again)
+static bool is_draw(const Searcher *s, int ply) {
+	if (s->pos.halfmove_clock >= 100) return true;
+	int window = s->pos.halfmove_clock;
+	if (!s->shared->history && window > ply) window = ply;
+	for (int back = 4; back <= window; back += 2) {
+		if (key_back(s, ply, back) == s->pos.key) return true;
+	}
+	return false;
+}
+
+// Mate scores are stored relative to the node, not to the root
+static inline int score_to_tt(int score, int ply) {
+	return score > SCORE_MATE - MAX_SEARCH_PLY ? score + ply : score < -SCORE_MATE + MAX_SEARCH_PLY ? score - ply : score;
+}
+
+static inline int score_from_tt(int score, int ply) {
+	return score > SCORE_MATE - MAX_SEARCH_PLY ? score - ply : score < -SCORE_MATE + MAX_SEARCH_PLY ? score + ply : score;
+}
+
+// Remember a quiet move that caused a cutoff, for the siblings and the move ordering
+static void update_quiet_stats(Searcher *s, Move m, int depth, int ply) {
+	int *h = &s->history[s->pos.side_to_move][move_from(m)][move_to(m)];
+	*h += depth * depth;
+	if (*h > (1 << 20)) *h /= 2;
+	if (s->killers[ply][0] != m) {
+		s->killers[ply][1] = s->killers[ply][0];
+		s->killers[ply][0] = m;
+	}
+}
+
+// Count a node; false once the search has to stop
+static inline bool enter_node(Searcher *s, int ply) {
+	s->pv_length[ply] = 0;
+	atomic_store_explicit(&s->nodes, atomic_load_explicit(&s->nodes, memory_order_relaxed) + 1, memory_order_relaxed);
+	check_limits(s);
+	return !stopped(s);
+}
+
+static inline int static_eval(Searcher *s) {
+	return evaluate(&s->pos, s->pawns.entries ? &s->pawns : NULL);
+}
+
+#define DELTA_MARGIN 200 // what positional gains a capture may bring on top of the material
+
+// Quiescence search: only captures (and queen promotions) until the position is quiet, so
+// that leaves are never evaluated in the middle of an exchange. The side to move may also
+// "stand pat" on the static evaluation, except in check, where every evasion is searched.
+static int qsearch(Searcher *s, int alpha, int beta, int ply) {
+	if (!enter_node(s, ply)) return 0;
+	if (s->pos.halfmove_clock >= 100) return 0;
+	if (ply >= MAX_SEARCH_PLY - 1) return static_eval(s);
+
+	bool in_check = is_in_check(&s->pos, s->pos.side_to_move);
+	int best = -SCORE_INF;
+	int stand_pat = 0;
+	MovePicker mp;
+	if (in_check) {
+		picker_init(&mp, &s->pos, MOVE_NONE, s->killers[ply], &s->history[s->pos.side_to_move][0][0]);
+	} else {
+		stand_pat = best = static_eval(s);
+		if (best >= beta) return best;
+		if (best > alpha) alpha = best;
+		picker_init_captures(&mp, &s->pos);
+	}
+
+	Move m;
+	while ((m = picker_next(&mp)) != MOVE_NONE) {
+		// Delta pruning: even winning the piece outright can't bring the score up to alpha
+		if (!in_check && !move_is_promotion(m)) {
+			Piece victim = s->pos.board[move_to(m)];
+			int gain = victim == NO_PIECE ? piece_value[PAWN] : piece_value[piece_type(victim)];
+			if (stand_pat + gain + DELTA_MARGIN <= alpha) continue;
+		}
+		push_move(&s->pos, &s->st, m);
+		int score = -qsearch(s, -beta, -alpha, ply + 1);
+		pop_move(&s->pos, &s->st);
+		if (stopped(s)) return 0;
+
+		if (score > best) {
+			best = score;
+			if (score > alpha) {
+				alpha = score;
+				if (score >= beta) break;
+			}
+		}
+	}
+	if (in_check && best == -SCORE_INF) return -SCORE_MATE + ply;
+	return best;
+}
+
+static int negamax(Searcher *s, int alpha, int beta, int depth, int ply) {
+	if (depth <= 0) return qsearch(s, alpha, beta, ply);
+	if (!enter_node(s, ply)) return 0;
+
+	if (ply > 0 && is_draw(s, ply)) return 0;
+	if (ply >= MAX_SEARCH_PLY - 1) return static_eval(s);
+
+	TransTable *tt = s->shared->tt;
+	TTHit hit = {MOVE_NONE, 0, 0, BOUND_NONE};
+	if (tt && tt_probe(tt, s->pos.key, &hit) && ply > 0 && hit.depth >= depth) {
+		int score = score_from_tt(hit.score, ply);
+		if (hit.bound == BOUND_EXACT || (hit.bound == BOUND_LOWER && score >= beta) ||
+		    (hit.bound == BOUND_UPPER && score <= alpha)) return score;
+	}
+
+	MovePicker mp;
+	picker_init(&mp, &s->pos, hit.move, s->killers[ply], &s->history[s->pos.side_to_move][0][0]);
+
+	int old_alpha = alpha;
+	int best = -SCORE_INF;
+	Move best_move = MOVE_NONE;
+	int played = 0;
+	Move m;
+	while ((m = picker_next(&mp)) != MOVE_NONE) {
+		played++;
+		push_move(&s->pos, &s->st, m);
+		int score = -negamax(s, -beta, -alpha, depth - 1, ply + 1);
+		pop_move(&s->pos, &s->st);
+		if (stopped(s)) return 0;
+
+		if (score > best) {
+			best = score;
+			if (score > alpha) {
+				best_move = m;
+				alpha = score;
+				// New best line: this move followed by the child's PV
+				s->pv[ply][0] = m;
+				memcpy(&s->pv[ply][1], s->pv[ply + 1], s->pv_length[ply + 1] * sizeof(Move));
+				s->pv_length[ply] = s->pv_length[ply + 1] + 1;
+				if (score >= beta) {
+					if (!move_is_capture(m) && !move_is_promotion(m)) update_quiet_stats(s, m, depth, ply);
+					break;
+				}
+			}
+		}
+	}
+	if (played == 0) {
+		return is_in_check(&s->pos, s->pos.side_to_move) ? -SCORE_MATE + ply : 0;
+	}
+	if (tt) {
+		int bound = best >= beta ? BOUND_LOWER : best > old_alpha ? BOUND_EXACT : BOUND_UPPER;
+		tt_store(tt, s->pos.key, best_move, score_to_tt(best, ply), depth, bound);
+	}
+	return best;
+}
+
+static void print_info(const SearchResult *r) {
+	char uci[6];
+	flockfile(stdout); // one whole line, even if another thread is answering the GUI
+	printf("info depth %d score ", r->depth);
+	if (IS_MATE_SCORE(r->score)) {
+		printf("mate %d", r->score > 0 ? (SCORE_MATE - r->score + 1) / 2 : -(SCORE_MATE + r->score) / 2);
+	} else {
+		printf("cp %d", r->score);
+	}
+	printf(" nodes %llu nps %.0f hashfull %d time %.0f pv", (unsigned long long)r->nodes,
+	       r->seconds > 0 ? r->nodes / r->seconds : 0.0, r->hashfull, r->seconds * 1000);
+	for (int i = 0; i < r->pv_length; i++) {
+		move_to_uci(r->pv[i], uci);
+		printf(" %s", uci);
+	}
+	printf("\n");
+	fflush(stdout);
+	funlockfile(stdout);
+}
+
+// Iterative deepening on one thread. Helpers with an odd id run one ply ahead of the main
+// thread, so that the threads don't all search the same tree in the same order.
+static void iterate(Searcher *s) {
+	SearchShared *sh = s->shared;
+	const SearchLimits *l = &sh->limits;
+	int stability = 0;
+	for (int depth = 1 + (s->id & 1); depth < MAX_SEARCH_PLY; depth++) {
+		// Checked on every iteration, like the other limits: pondering may have ended since
+		if (!unlimited(l) && l->depth > 0 && depth > l->depth) break;
+		int score = negamax(s, -SCORE_INF, SCORE_INF, depth, 0);
+		if (stopped(s)) break; // an unfinished iteration is thrown away
+
+		SearchResult *r = &s->result;
+		Move previous = r->depth > 0 ? r->best_move : MOVE_NONE;
+		r->depth = depth;
+		r->score = score;
+		r->pv_length = s->pv_length[0];
+		memcpy(r->pv, s->pv[0], s->pv_length[0] * sizeof(Move));
+		if (r->pv_length > 0) r->best_move = r->pv[0];
+		stability = r->best_move == previous ? stability + 1 : 0;
+		if (s->id != 0) continue;
+
+		r->nodes = total_nodes(sh);
+		r->seconds = tm_elapsed(&sh->tm);
+		r->hashfull = sh->tt ? tt_hashfull(sh->tt) : 0;
+		print_info(r);
+		if (unlimited(l)) continue;
+		// A forced mate found within the depth won't get any shorter
+		if (IS_MATE_SCORE(score) && SCORE_MATE - abs(score) <= depth) break;
+		if (tm_soft_expired(&sh->tm, stability)) break;
+	}
+	// The main thread's search is the one that counts: once it is over, so is everyone's
+	if (s->id == 0) atomic_store_explicit(&sh->stop, true, memory_order_relaxed);
+}
+
+static void search_thread(void *ctx, size_t index, int worker) {
+	(void)worker;
+	SearchShared *sh = ctx;
+	iterate(&sh->threads[index]);
+}
+
+// Each thread votes for its best move with its score (above the worst one) times its depth
+static const Searcher *vote(const SearchShared *sh) {
+	const Searcher *best = &sh->threads[0];
+	int min_score = SCORE_INF;
+	for (int i = 0; i < sh->num_threads; i++) {
+		const SearchResult *r = &sh->threads[i].result;
+		if (r->depth > 0 && r->score < min_score) min_score = r->score;
+	}
+	int64_t best_votes = -1;
+	for (int i = 0; i < sh->num_threads; i++) {
+		const SearchResult *ri = &sh->threads[i].result;
+		if (ri->depth == 0) continue;
+		int64_t votes = 0;
+		for (int j = 0; j < sh->num_threads; j++) {
+			const SearchResult *rj = &sh->threads[j].result;
+			if (rj->depth > 0 && rj->best_move == ri->best_move) votes += (int64_t)(rj->score - min_score + 14) * rj->depth;
+		}
+		if (votes > best_votes || (votes == best_votes && ri->depth > best->result.depth)) {
+			best_votes = votes;
+			best = &sh->threads[i];
+		}
+	}
+	return best;
+}
+
+void search(const Position *pos, const GameHistory *history, TransTable *tt, const SearchLimits *limits,
+            int threads, SearchResult *result) {
+	memset(result, 0, sizeof(*result));
+	MoveList root;
+	generate_legal(pos, &root);
+	if (threads < 1) threads = 1;
+	SearchShared sh;
+	sh.threads = calloc(threads, sizeof(Searcher));
+	if (root.count == 0 || !sh.threads) {
+		free(sh.threads);
+		return;
+	}
+	sh.history = history;
+	sh.tt = tt;
+	sh.limits = *limits;
+	sh.num_threads = threads;
+	atomic_init(&sh.stop, false);
+	if (tt) tt_new_search(tt);
+
+	for (int i = 0; i < threads; i++) {
+		Searcher *s = &sh.threads[i];
+		s->shared = &sh;
+		s->id = i;
+		s->pos = *pos;
+		atomic_init(&s->nodes, 0);
+		pawn_table_init(&s->pawns);
+		// Whatever happens, there is a move to play
+		s->result.best_move = root.list[0];
+	}
+	tm_init(&sh.tm, limits->movetime_ms, limits->time_ms[pos->side_to_move], limits->inc_ms[pos->side_to_move],
+	        limits->movestogo);
+	pool_run(threads, threads, search_thread, &sh);
+
+	const Searcher *best = vote(&sh);
+	*result = best->result;
+	result->nodes = total_nodes(&sh);
+	result->seconds = tm_elapsed(&sh.tm);
+	result->hashfull = tt ? tt_hashfull(tt) : 0;
+	if (best->id != 0) print_info(result);
+	for (int i = 0; i < threads; i++) pawn_table_free(&sh.threads[i].pawns);
+	free(sh.threads);
+}
+
+int search_command(int argc, char **argv) {
+	SearchLimits limits = {0};
+	int clock_ms = 0;
+	int inc_ms = 0;
+	int hash_mb = 16;
+	int threads = 1;
+
+	// Options first: -d <depth>, -n <nodes>, -m <movetime in ms>, -c <clock in ms>, -i <increment in ms>,
+	// -g <moves to go>, -H <hash size in MB>, -t <threads>
+	while (argc >= 2 && argv[0][0] == '-') {
+		if (strcmp(argv[0], "-d") == 0) limits.depth = atoi(argv[1]);
+		else if (strcmp(argv[0], "-n") == 0) limits.nodes = strtoull(argv[1], NULL, 10);
+		else if (strcmp(argv[0], "-m") == 0) limits.movetime_ms = atoi(argv[1]);
+		else if (strcmp(argv[0], "-c") == 0) clock_ms = atoi(argv[1]);
+		else if (strcmp(argv[0], "-i") == 0) inc_ms = atoi(argv[1]);
+		else if (strcmp(argv[0], "-g") == 0) limits.movestogo = atoi(argv[1]);
+		else if (strcmp(argv[0], "-H") == 0) hash_mb = atoi(argv[1]);
+		else if (strcmp(argv[0], "-t") == 0) threads = atoi(argv[1]);
+		else break;
+		argc -= 2;
+		argv += 2;
+	}
+	if (!limits.depth && !limits.nodes && !limits.movetime_ms && !clock_ms) limits.depth = 6;
+
+	Position pos;
+	if (!parse_fen_args(argc, argv, &pos)) return EXIT_FAILURE;
+	// The clock given is the side to move's
+	limits.time_ms[pos.side_to_move] = clock_ms;
+	limits.inc_ms[pos.side_to_move] = inc_ms;
+
+	TransTable table;
+	TransTable *tt = NULL;
+	if (hash_mb > 0) {
+		if (!tt_init(&table, (size_t)hash_mb)) {
+			fprintf(stderr, "Cannot allocate %d MB of hash\n", hash_mb);
+			return EXIT_FAILURE;
+		}
+		tt = &table;
+	}
+
+	SearchResult result;
+	search(&pos, NULL, tt, &limits, threads, &result);
+	if (tt) tt_free(tt);
+	char uci[6] = "0000";
+	if (result.best_move != MOVE_NONE) move_to_uci(result.best_move, uci);
+	printf("bestmove %s\n", uci);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "tchess.h"
+#include "rules.h"
+#include "tt.h"
+#include <stdatomic.h>
+
+#define MAX_SEARCH_PLY 64
+#define SCORE_INF  32000
+#define SCORE_MATE 31000 // mate in n plies scores SCORE_MATE - n
+#define IS_MATE_SCORE(s) ((s) > SCORE_MATE - MAX_SEARCH_PLY || (s) < -SCORE_MATE + MAX_SEARCH_PLY)
+
+// Limits of one search; 0 means no limit
+typedef struct {
+	int depth;
+	uint64_t nodes;
+	int movetime_ms;
+	int time_ms[2];        // clocks, by color (see timeman.h)
+	int inc_ms[2];
+	int movestogo;
+	bool infinite;         // ignore all of the above: only a stop ends the search
+	atomic_bool *stop;     // may be NULL; set from another thread to stop the search
+	atomic_bool *ponder;   // may be NULL; while set, the search runs as if infinite (cleared on ponderhit)
+} SearchLimits;
+
+typedef struct {
+	Move best_move;          // MOVE_NONE if the side to move has no legal move
+	int score;               // centipawns, from the side to move's point of view
+	int depth;               // last completed iteration
+	uint64_t nodes;
+	double seconds;
+	int hashfull;            // permille of the transposition table in use
+	Move pv[MAX_SEARCH_PLY];
+	int pv_length;
+} SearchResult;
+
+// Iterative deepening alpha-beta search of pos, printing one "info" line per completed depth.
+// history (may be NULL) holds the game up to and including pos, for repetition draws;
+// tt (may be NULL) is the transposition table. With more than one thread the helpers search
+// the same position on their own (Lazy SMP), sharing only the table, and the threads vote on
+// the move to play once the main thread stops.
+void search(const Position *pos, const GameHistory *history, TransTable *tt, const SearchLimits *limits,
+            int threads, SearchResult *result);
+
+// Command line entry point: tchess search [-d depth] [-n nodes] [-m movetime_ms] [-c clock_ms]
+//                                        [-i inc_ms] [-g movestogo] [-H hash_mb] [-t threads] [fen]
+int search_command(int argc, char **argv);
+
+#endif // SEARCH_H
@@ -0,0 +1,77 @@
+#include "see.h"
+#include "bitboard.h"
+#include "eval.h"
+#include "directions.h"
+
+// Material taken by the move itself, promotion included
+static int capture_gain(const Position *pos, Move move) {
+	Piece victim = pos->board[move_to(move)];
+	int gain = move_flags(move) == FLAG_EN_PASSANT ? piece_value[PAWN] :
+	           victim == NO_PIECE ? 0 : piece_value[piece_type(victim)];
+	if (move_is_promotion(move)) gain += piece_value[move_promotion_type(move)] - piece_value[PAWN];
+	return gain;
+}
+
+// Value of what stands on the target square once the move is made
+static int moved_value(const Position *pos, Move move) {
+	if (move_is_promotion(move)) return piece_value[move_promotion_type(move)];
+	return piece_value[piece_type(pos->board[move_from(move)])];
+}
+
+int see(const Position *pos, Move move) {
+	if (move_is_castling(move)) return 0;
+	Square from = move_from(move);
+	Square to = move_to(move);
+	Color side = pos->side_to_move;
+	const Bitboard *pc = pos->pieces;
+	Bitboard diagonal = pc[WHITE_BISHOP] | pc[BLACK_BISHOP] | pc[WHITE_QUEEN] | pc[BLACK_QUEEN];
+	Bitboard straight = pc[WHITE_ROOK] | pc[BLACK_ROOK] | pc[WHITE_QUEEN] | pc[BLACK_QUEEN];
+
+	Bitboard occ = pos->occupied ^ sq_bb(from);
+	if (move_flags(move) == FLAG_EN_PASSANT) occ ^= sq_bb(side == WHITE ? to + S : to + N);
+	Bitboard attackers = attackers_to(pos, to, occ) & occ;
+
+	// gain[d]: what the side making the d-th capture has won if the sequence stops after it
+	int gain[32];
+	int d = 0;
+	gain[0] = capture_gain(pos, move);
+	int on_target = moved_value(pos, move);
+	side = !side;
+	while (d < 31) {
+		Bitboard ours = attackers & pos->colors[side];
+		if (!ours) break;
+		PieceType t = PAWN;
+		Bitboard b = 0;
+		for (; t <= KING; t++) {
+			if ((b = ours & pc[make_piece(side, t)])) break;
+		}
+		// The king may only take last
+		if (t == KING && (attackers & pos->colors[!side])) break;
+
+		d++;
+		gain[d] = on_target - gain[d - 1];
+		on_target = piece_value[t];
+		occ ^= sq_bb(lsb(b));
+		// Sliders lined up behind the piece that just took join in
+		if (t == PAWN || t == BISHOP || t == QUEEN) attackers |= bishop_attacks(to, occ) & diagonal;
+		if (t == ROOK || t == QUEEN) attackers |= rook_attacks(to, occ) & straight;
+		attackers &= occ;
+		side = !side;
+	}
+	// Each side only goes on with the exchange if it gains by it
+	while (d > 0) {
+		if (gain[d] > -gain[d - 1]) gain[d - 1] = -gain[d];
+		d--;
+	}
+	return gain[0];
+}
+
+bool see_ge(const Position *pos, Move move, int threshold) {
+	if (move_is_castling(move)) return threshold <= 0;
+	// More than the capture itself can't be won; if losing the moved piece still leaves
+	// enough, the answer doesn't depend on the rest of the exchange
+	int gain = capture_gain(pos, move);
+	if (gain < threshold) return false;
+	if (gain - moved_value(pos, move) >= threshold) return true;
+	return see(pos, move) >= threshold;
+}
@@ -0,0 +1,12 @@
+#ifndef SEE_H
+#define SEE_H
+
+#include "tchess.h"
+
+// Static exchange evaluation: material won (in centipawns, for the side to move) by the
+// capture sequence on the target square of move, each side always recapturing with its least
+// valuable piece and free to stop when going on would lose. Pins are not taken into account.
+int see(const Position *pos, Move move);
+bool see_ge(const Position *pos, Move move, int threshold); // see(pos, move) >= threshold
+
+#endif // SEE_H
@@ -1,5 +1,7 @@
 #include "tchess.h"
+#include "bitboard.h"
 #include "directions.h"
+#include "eval.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,23 +38,288 @@ void init_position(Position *pos){
 			}
 		}
 	}
+	update_bitboards(pos);
+	pos->key = compute_key(pos);
 }
 
-// Auxiliary function to convert square index to string (e.g., 0 -> "a1")
-char* square_to_string(Square square) {
-	char *buffer = malloc(3 * sizeof(char));
+// Random numbers identifying each piece on each square, the castling rights, the en passant
+// file and the side to move; a position's key is the XOR of those that apply to it
+static uint64_t zobrist_piece[NUM_PIECES][NUM_SQUARES];
+static uint64_t zobrist_castling[16];
+static uint64_t zobrist_ep_file[NUM_FILES];
+static uint64_t zobrist_side;
+
+// splitmix64, with a fixed seed so that keys are the same on every run
+static uint64_t next_random(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+void init_zobrist(void) {
+	uint64_t state = 0x7463686573730000ULL;
+	for (int p = 0; p < NUM_PIECES; p++)
+		for (Square sq = 0; sq < NUM_SQUARES; sq++)
+			zobrist_piece[p][sq] = (p == NO_PIECE) ? 0 : next_random(&state);
+	for (int i = 0; i < 16; i++) zobrist_castling[i] = next_random(&state);
+	for (int f = 0; f < NUM_FILES; f++) zobrist_ep_file[f] = next_random(&state);
+	zobrist_side = next_random(&state);
+}
+
+// The en passant file only counts when the side to move has a pawn that can take
+static inline bool ep_in_key(const Position *pos) {
+	Square ep = pos->en_passant_target;
+	Color c = pos->side_to_move;
+	return ep != NO_SQUARE && (pawn_attacks[!c][ep] & pos->pieces[make_piece(c, PAWN)]);
+}
+
+// Compute the key from scratch (make_move updates it incrementally)
+uint64_t compute_key(const Position *pos) {
+	uint64_t key = 0;
+	for (Square sq = 0; sq < NUM_SQUARES; sq++) key ^= zobrist_piece[pos->board[sq]][sq];
+	key ^= zobrist_castling[pos->castling_rights & 0x0F];
+	if (ep_in_key(pos)) key ^= zobrist_ep_file[file_of(pos->en_passant_target)];
+	if (pos->side_to_move == BLACK) key ^= zobrist_side;
+	return key;
+}
+
+// Rebuild the bitboards from the board array
+void update_bitboards(Position *pos) {
+	memset(pos->pieces, 0, sizeof(pos->pieces));
+	memset(pos->colors, 0, sizeof(pos->colors));
+	pos->score_mg = pos->score_eg = pos->phase = 0;
+	pos->pawn_key = 0;
+	pos->king_sq[WHITE] = pos->king_sq[BLACK] = NO_SQUARE;
+	for (Square sq = 0; sq < NUM_SQUARES; sq++) {
+		Piece p = pos->board[sq];
+		if (p == NO_PIECE) continue;
+		if (piece_type(p) == KING) pos->king_sq[piece_color(p)] = sq;
+		pos->pieces[p] |= sq_bb(sq);
+		pos->colors[piece_color(p)] |= sq_bb(sq);
+		pos->score_mg += psqt_mg[p][sq];
+		pos->score_eg += psqt_eg[p][sq];
+		pos->phase += phase_weight[p];
+		if (piece_type(p) == PAWN) pos->pawn_key ^= zobrist_piece[p][sq];
+	}
+	pos->occupied = pos->colors[WHITE] | pos->colors[BLACK];
+}
+
+// Board updates used by make_move, keeping the board array and the bitboards in sync
+static inline void put_piece(Position *pos, Piece p, Square sq) {
+	Bitboard b = sq_bb(sq);
+	pos->board[sq] = p;
+	pos->pieces[p] |= b;
+	pos->colors[piece_color(p)] |= b;
+	pos->occupied |= b;
+	pos->key ^= zobrist_piece[p][sq];
+	if (piece_type(p) == PAWN) pos->pawn_key ^= zobrist_piece[p][sq];
+	pos->score_mg += psqt_mg[p][sq];
+	pos->score_eg += psqt_eg[p][sq];
+	pos->phase += phase_weight[p];
+}
+
+static inline void remove_piece(Position *pos, Square sq) {
+	Bitboard b = sq_bb(sq);
+	Piece p = pos->board[sq];
+	pos->board[sq] = NO_PIECE;
+	pos->pieces[p] &= ~b;
+	pos->colors[piece_color(p)] &= ~b;
+	pos->occupied &= ~b;
+	pos->key ^= zobrist_piece[p][sq];
+	if (piece_type(p) == PAWN) pos->pawn_key ^= zobrist_piece[p][sq];
+	pos->score_mg -= psqt_mg[p][sq];
+	pos->score_eg -= psqt_eg[p][sq];
+	pos->phase -= phase_weight[p];
+}
+
+static inline void move_piece(Position *pos, Square from, Square to) {
+	Bitboard b = sq_bb(from) | sq_bb(to);
+	Piece p = pos->board[from];
+	pos->board[from] = NO_PIECE;
+	pos->board[to] = p;
+	pos->pieces[p] ^= b;
+	pos->colors[piece_color(p)] ^= b;
+	pos->occupied ^= b;
+	pos->key ^= zobrist_piece[p][from] ^ zobrist_piece[p][to];
+	if (piece_type(p) == PAWN) pos->pawn_key ^= zobrist_piece[p][from] ^ zobrist_piece[p][to];
+	pos->score_mg += psqt_mg[p][to] - psqt_mg[p][from];
+	pos->score_eg += psqt_eg[p][to] - psqt_eg[p][from];
+	if (piece_type(p) == KING) pos->king_sq[piece_color(p)] = to; // kings are only ever moved
+}
+
+// Parse a position in Forsyth-Edwards Notation; the move counters may be omitted.
+// Returns false (pos is then unspecified) if the string is malformed.
+bool parse_fen(const char *fen, Position *pos) {
+	static const char piece_chars[] = " PNBRQKpnbrqk";
+	memset(pos, 0, sizeof(Position));
+	const char *p = fen;
+	while (*p == ' ') p++;
+
+	// 1) Piece placement, from rank 8 to rank 1
+	int file = 0, rank = 7;
+	for (; *p && *p != ' '; p++) {
+		if (*p == '/') {
+			if (file != NUM_FILES || rank == 0) return false;
+			file = 0;
+			rank--;
+		} else if (*p >= '1' && *p <= '8') {
+			file += *p - '0';
+			if (file > NUM_FILES) return false;
+		} else {
+			const char *pc = strchr(piece_chars + 1, *p);
+			if (!pc || file >= NUM_FILES) return false;
+			pos->board[SQ(file, rank)] = (Piece)(pc - piece_chars);
+			file++;
+		}
+	}
+	if (rank != 0 || file != NUM_FILES) return false;
+
+	// 2) Side to move
+	while (*p == ' ') p++;
+	if (*p == 'w') pos->side_to_move = WHITE;
+	else if (*p == 'b') pos->side_to_move = BLACK;
+	else return false;
+	p++;
+
+	// 3) Castling rights
+	while (*p == ' ') p++;
+	pos->castling_rights = 0;
+	for (; *p && *p != ' '; p++) {
+		switch (*p) {
+			case 'K': pos->castling_rights |= WHITE_KING_SIDE_CASTLING; break;
+			case 'Q': pos->castling_rights |= WHITE_QUEEN_SIDE_CASTLING; break;
+			case 'k': pos->castling_rights |= BLACK_KING_SIDE_CASTLING; break;
+			case 'q': pos->castling_rights |= BLACK_QUEEN_SIDE_CASTLING; break;
+			case '-': break;
+			default: return false;
+		}
+	}
+
+	// 4) En passant target
+	while (*p == ' ') p++;
+	pos->en_passant_target = NO_SQUARE;
+	if (*p == '-') {
+		p++;
+	} else if (p[0] >= 'a' && p[0] <= 'h' && (p[1] == '3' || p[1] == '6')) {
+		pos->en_passant_target = SQ(p[0] - 'a', p[1] - '1');
+		p += 2;
+	} else {
+		return false;
+	}
+
+	// 5) Halfmove clock and fullmove number (optional)
+	pos->halfmove_clock = (int)strtol(p, (char **)&p, 10);
+	pos->fullmove_number = (int)strtol(p, (char **)&p, 10);
+	if (pos->fullmove_number < 1) pos->fullmove_number = 1;
+
+	update_bitboards(pos);
+
+	// Exactly one king per side, and castling rights only with king and rook at home
+	if (popcount(pos->pieces[WHITE_KING]) != 1 || popcount(pos->pieces[BLACK_KING]) != 1) return false;
+	if (pos->board[E1] != WHITE_KING) pos->castling_rights &= ~(WHITE_KING_SIDE_CASTLING | WHITE_QUEEN_SIDE_CASTLING);
+	if (pos->board[E8] != BLACK_KING) pos->castling_rights &= ~(BLACK_KING_SIDE_CASTLING | BLACK_QUEEN_SIDE_CASTLING);
+	if (pos->board[H1] != WHITE_ROOK) pos->castling_rights &= ~WHITE_KING_SIDE_CASTLING;
+	if (pos->board[A1] != WHITE_ROOK) pos->castling_rights &= ~WHITE_QUEEN_SIDE_CASTLING;
+	if (pos->board[H8] != BLACK_ROOK) pos->castling_rights &= ~BLACK_KING_SIDE_CASTLING;
+	if (pos->board[A8] != BLACK_ROOK) pos->castling_rights &= ~BLACK_QUEEN_SIDE_CASTLING;
+	// An en passant square must lie just behind a pawn of the side that has just pushed
+	Square ep = pos->en_passant_target;
+	if (ep != NO_SQUARE) {
+		bool white = pos->side_to_move == WHITE;
+		Square pushed = white ? ep + S : ep + N;
+		if (rank_of(ep) != (white ? 5 : 2) || pos->board[ep] != NO_PIECE ||
+		    pos->board[pushed] != (white ? BLACK_PAWN : WHITE_PAWN))
+			pos->en_passant_target = NO_SQUARE;
+	}
+	pos->key = compute_key(pos);
+	return true;
+}
+
+// Auxiliary function to convert square index to string (e.g., A1 -> "a1"), in a caller buffer
+char* square_name(Square square, char buffer[3]) {
 	if (square < 0 || square >= NUM_SQUARES) {
-		strcpy(buffer, "??\0");
+		strcpy(buffer, "??");
 		return buffer;
 	}
-	int file = file_of(square);
-	int rank = rank_of(square);
-	buffer[0] = (char)('a' + file);
-	buffer[1] = (char)('1' + rank);
+	buffer[0] = (char)('a' + file_of(square));
+	buffer[1] = (char)('1' + rank_of(square));
 	buffer[2] = '\0';
 	return buffer;
 }
 
+// Same, in a heap buffer the caller must free
+char* square_to_string(Square square) {
+	char *buffer = malloc(3 * sizeof(char));
+	if (!buffer) return NULL;
+	return square_name(square, buffer);
+}
+
+// Write a move in UCI coordinate notation (e.g. "e2e4", "e7e8q"); returns its length
+int move_to_uci(Move move, char buffer[6]) {
+	square_name(move_from(move), buffer);
+	square_name(move_to(move), buffer + 2);
+	if (move_is_promotion(move)) {
+		buffer[4] = "nbrq"[move_promotion_type(move) - KNIGHT];
+		buffer[5] = '\0';
+		return 5;
+	}
+	return 4;
+}
+
+// Command line FEN: it may come as one argument or split over several
+bool parse_fen_args(int argc, char **argv, Position *pos) {
+	char fen[256] = START_FEN;
+	if (argc > 0) {
+		fen[0] = '\0';
+		for (int i = 0; i < argc; i++) {
+			if (strlen(fen) + strlen(argv[i]) + 2 > sizeof(fen)) break;
+			if (i > 0) strcat(fen, " ");
+			strcat(fen, argv[i]);
+		}
+	}
+	if (parse_fen(fen, pos)) return true;
+	fprintf(stderr, "Invalid FEN: %s\n", fen);
+	return false;
+}
+
+// Write the position as a FEN string; buffer must hold FEN_MAX characters
+char* position_to_fen(const Position *pos, char *buffer) {
+	char *p = buffer;
+	for (int rank = 7; rank >= 0; rank--) {
+		int empty = 0;
+		for (int file = 0; file < NUM_FILES; file++) {
+			Piece pc = pos->board[SQ(file, rank)];
+			if (pc == NO_PIECE) {
+				empty++;
+				continue;
+			}
+			if (empty) *p++ = (char)('0' + empty);
+			empty = 0;
+			*p++ = piece_to_char(pc);
+		}
+		if (empty) *p++ = (char)('0' + empty);
+		if (rank > 0) *p++ = '/';
+	}
+	*p++ = ' ';
+	*p++ = pos->side_to_move == WHITE ? 'w' : 'b';
+	*p++ = ' ';
+	if (pos->castling_rights & WHITE_KING_SIDE_CASTLING) *p++ = 'K';
+	if (pos->castling_rights & WHITE_QUEEN_SIDE_CASTLING) *p++ = 'Q';
+	if (pos->castling_rights & BLACK_KING_SIDE_CASTLING) *p++ = 'k';
+	if (pos->castling_rights & BLACK_QUEEN_SIDE_CASTLING) *p++ = 'q';
+	if (!pos->castling_rights) *p++ = '-';
+	*p++ = ' ';
+	if (pos->en_passant_target == NO_SQUARE) {
+		*p++ = '-';
+	} else {
+		square_name(pos->en_passant_target, p);
+		p += 2;
+	}
+	snprintf(p, FEN_MAX - (p - buffer), " %d %d", pos->halfmove_clock, pos->fullmove_number);
+	return buffer;
+}
+
 // Auxiliary function to convert piece enum to character
 char piece_to_char(Piece p) {
     switch (p) {
@@ -126,43 +393,133 @@ void print_board(const Position *pos) {
     printf("\n\n");
 }
 
-// Parse the move string
-Move* parse_move(const char *move_str) {
-	Move *move = malloc(sizeof(Move));
-	if (!move) {
-		return NULL; // Memory allocation failed
+// Parse a move in UCI coordinate notation into 'move'; false if the string isn't one.
+// The move type is only known once matched against the generated moves.
+bool move_from_uci(const char *move_str, MoveInfo *move) {
+	size_t len = strlen(move_str);
+	if (len < 4 || len > 5) return false; // Invalid move string length
+	for (int i = 0; i < 4; i += 2) {
+		if (move_str[i] < 'a' || move_str[i] > 'h' || move_str[i + 1] < '1' || move_str[i + 1] > '8')
+			return false; // Invalid square
 	}
-	if (strlen(move_str) < 4 || strlen(move_str) > 5) {
-		free(move);
-		return NULL; // Invalid move string length
+	if (len == 5 && !strchr("qrbn", move_str[4])) return false;
+
+	move->from = SQ(move_str[0] - 'a', move_str[1] - '1');
+	move->to = SQ(move_str[2] - 'a', move_str[3] - '1');
+	move->promotionPiece = (len == 5) ? move_str[4] : NO_PIECE;
+	move->type = (len == 5) ? PROMOTION : NORMAL; // Default move type
+	return true;
+}
+
+Move move_pack(MoveInfo info) {
+	switch (info.type) {
+		case CASTLING_KINGSIDE:  return new_move(info.from, info.to, FLAG_KING_CASTLE);
+		case CASTLING_QUEENSIDE: return new_move(info.from, info.to, FLAG_QUEEN_CASTLE);
+		case EN_PASSANT:         return new_move(info.from, info.to, FLAG_EN_PASSANT);
+		case CAPTURE:            return new_move(info.from, info.to, FLAG_CAPTURE);
+		case PROMOTION: {
+			const char *p = strchr("nbrq", info.promotionPiece);
+			return new_move(info.from, info.to, FLAG_PROMOTION + (p && *p ? (int)(p - "nbrq") : 3));
+		}
+		default:                 return new_move(info.from, info.to, FLAG_QUIET);
 	}
-	if (strlen(move_str) == 5) {	
-		move->promotionPiece = move_str[4];
+}
+
+MoveInfo move_unpack(Move move) {
+	MoveInfo info = {move_from(move), move_to(move), NORMAL, NO_PIECE};
+	switch (move_flags(move)) {
+		case FLAG_KING_CASTLE:  info.type = CASTLING_KINGSIDE; break;
+		case FLAG_QUEEN_CASTLE: info.type = CASTLING_QUEENSIDE; break;
+		case FLAG_EN_PASSANT:   info.type = EN_PASSANT; break;
+		case FLAG_CAPTURE:      info.type = CAPTURE; break;
+		default:
+			if (move_is_promotion(move)) {
+				info.type = PROMOTION;
+				info.promotionPiece = "nbrq"[move_promotion_type(move) - KNIGHT];
+			}
 	}
-	else {
-		move->promotionPiece = NO_PIECE;
+	return info;
+}
+
+// Parse the move string into a heap-allocated move the caller must free
+MoveInfo* parse_move(const char *move_str) {
+	MoveInfo *move = malloc(sizeof(MoveInfo));
+	if (!move) {
+		return NULL; // Memory allocation failed
 	}
-	move->from = SQ((int)(move_str[0] - 'a'), (int)(move_str[1] - '1'));
-	move->to = SQ((int)(move_str[2] - 'a'), (int)(move_str[3] - '1'));
-	if (move->from >= NUM_SQUARES || move->to >= NUM_SQUARES) {
-		printf("%d %d\n", move->from, move->to);
+	if (!move_from_uci(move_str, move)) {
 		free(move);
-		return NULL; // Invalid square
+		return NULL;
 	}
-	move->type = NORMAL; // Default move type
 	return move;
 }
 
-// Make a move on the board (doesn't check legality)
-int make_move(Position *pos, const Move *move) {
-    Square from = move->from;
-    Square to   = move->to;
+// Parse a UCI move and fill in its flags from the board; MOVE_NONE if the string isn't a
+// move or there is no piece of the side to move on its from square. A pawn reaching the last
+// rank without a promotion letter promotes to a queen. Legality is not checked.
+Move uci_to_move(const Position *pos, const char *move_str) {
+	MoveInfo info;
+	if (!move_from_uci(move_str, &info)) return MOVE_NONE;
+	Piece moving = pos->board[info.from];
+	if (moving == NO_PIECE || piece_color(moving) != pos->side_to_move) return MOVE_NONE;
+
+	bool capture = pos->board[info.to] != NO_PIECE;
+	int flags = capture ? FLAG_CAPTURE : FLAG_QUIET;
+	if (piece_type(moving) == PAWN) {
+		int dr = rank_of(info.to) - rank_of(info.from);
+		if (rank_of(info.to) == 0 || rank_of(info.to) == 7) {
+			char promo = info.type == PROMOTION ? info.promotionPiece : 'q';
+			flags = (capture ? FLAG_PROMOTION_CAPTURE : FLAG_PROMOTION) + (int)(strchr("nbrq", promo) - "nbrq");
+		} else if (dr == 2 || dr == -2) {
+			flags = FLAG_DOUBLE_PUSH;
+		} else if (info.to == pos->en_passant_target && file_of(info.to) != file_of(info.from)) {
+			flags = FLAG_EN_PASSANT;
+		}
+	} else if (piece_type(moving) == KING && abs(file_of(info.to) - file_of(info.from)) == 2) {
+		flags = file_of(info.to) > file_of(info.from) ? FLAG_KING_CASTLE : FLAG_QUEEN_CASTLE;
+	}
+	if (info.type == PROMOTION && !(flags & FLAG_PROMOTION)) return MOVE_NONE; // letter on a non-promotion
+	return new_move(info.from, info.to, flags);
+}
+
+int make_move(Position *pos, Move move) {
+	Undo undo;
+	return make_move_undo(pos, move, &undo);
+}
+
+// Make a move and save in 'undo' what unmake_move needs to take it back.
+// Returns 0 and leaves the position untouched if the move doesn't fit the board.
+int make_move_undo(Position *pos, Move move, Undo *undo) {
+    Square from = move_from(move);
+    Square to   = move_to(move);
+    int flags = move_flags(move);
     Piece  moving = pos->board[from];
     if (moving == NO_PIECE) return 0;
 
     Color c_us = pos->side_to_move;
     Color c_them = !c_us;
 	if (piece_color(moving) != c_us) return 0;
+
+	// Validate special moves before touching the board
+	if (move_is_castling(move) && piece_type(moving) != KING) return 0;
+	if ((flags == FLAG_EN_PASSANT || move_is_promotion(move)) && piece_type(moving) != PAWN) return 0;
+	if (flags == FLAG_EN_PASSANT) {
+		if (pos->en_passant_target == NO_SQUARE) return 0;
+		Square taken_sq = c_us == WHITE ? pos->en_passant_target + S : pos->en_passant_target + N;
+		if (pos->board[taken_sq] != make_piece(c_them, PAWN)) return 0;
+	}
+
+	undo->move = move;
+	undo->captured = NO_PIECE;
+	undo->castling_rights = pos->castling_rights;
+	undo->en_passant_target = pos->en_passant_target;
+	undo->halfmove_clock = pos->halfmove_clock;
+	undo->key = pos->key;
+
+	// Flip the side to move and take the old castling rights and en passant file out of the
+	// key; the new ones are put in at the end
+	pos->key ^= zobrist_castling[pos->castling_rights & 0x0F] ^ zobrist_side;
+	if (ep_in_key(pos)) pos->key ^= zobrist_ep_file[file_of(pos->en_passant_target)];
 	
 	// Save previous en passant target to check at the end if it changed
 	Square prev_ep = pos->en_passant_target;
@@ -176,25 +533,19 @@ int make_move(Position *pos, const Move *move) {
     // --- SPECIAL MOVES ---
 
     // 1) CASTLING (moving king and rook) 
-    if (move->type == CASTLING_KINGSIDE || move->type == CASTLING_QUEENSIDE) {
-		// Verify it is the correct king
-        if (!((c_us==WHITE && moving==WHITE_KING) || (c_us==BLACK && moving==BLACK_KING))) return 0;
-
+    if (move_is_castling(move)) {
         // Move king
-        pos->board[to]   = moving;
-        pos->board[from] = NO_PIECE;
+        move_piece(pos, from, to);
 
         // Move rook 
-        if (move->type == CASTLING_KINGSIDE) {
+        if (flags == FLAG_KING_CASTLE) {
             Square rook_from = (c_us==WHITE) ? H1 : H8; // H1/H8
             Square rook_to   = (c_us==WHITE) ? F1 : F8; // F1/F8
-            pos->board[rook_to]   = pos->board[rook_from];
-            pos->board[rook_from] = NO_PIECE;
+            move_piece(pos, rook_from, rook_to);
         } else {
             Square rook_from = (c_us==WHITE) ? A1 : A8; // A1/A8
             Square rook_to   = (c_us==WHITE) ? D1 : D8; // D1/D8
-            pos->board[rook_to]   = pos->board[rook_from];
-            pos->board[rook_from] = NO_PIECE;
+            move_piece(pos, rook_from, rook_to);
         }
 
         // Remove castling rights for this side 
@@ -204,26 +555,23 @@ int make_move(Position *pos, const Move *move) {
             pos->castling_rights &= ~(BLACK_KING_SIDE_CASTLING | BLACK_QUEEN_SIDE_CASTLING);
     }
     // 2) EN PASSANT 
-    else if (move->type == EN_PASSANT) {
-        if (piece_type(moving) != PAWN) return 0; 
+    else if (flags == FLAG_EN_PASSANT) {
 		Square ep_target = pos->en_passant_target;
         Square taken_sq = c_us == WHITE ? ep_target + S : ep_target + N; // Square of the pawn being captured 
         captured = pos->board[taken_sq];
-        if (captured != WHITE_PAWN && captured != BLACK_PAWN) return 0; 
 
-        pos->board[ep_target] = moving;
-        pos->board[from] = NO_PIECE; 
-        pos->board[taken_sq] = NO_PIECE;
+        remove_piece(pos, taken_sq);
+        move_piece(pos, from, ep_target);
         cap_sq = taken_sq;
 
         pos->halfmove_clock = 0;
     }
     // 3) PROMOTION 
-    else if (move->type == PROMOTION) {
-        if (piece_type(moving) != PAWN) return 0;
+    else if (move_is_promotion(move)) {
         captured = pos->board[to]; // if a piece is on 'to', it's a capture 
-        pos->board[to]   = promo_to_piece(c_us, move->promotionPiece);
-        pos->board[from] = NO_PIECE;
+        if (captured != NO_PIECE) remove_piece(pos, to);
+        remove_piece(pos, from);
+        put_piece(pos, make_piece(c_us, move_promotion_type(move)), to);
  
         pos->halfmove_clock = 0;
     }
@@ -231,8 +579,8 @@ int make_move(Position *pos, const Move *move) {
     else {
         captured = pos->board[to];
 
-        pos->board[to]   = moving;
-        pos->board[from] = NO_PIECE;
+        if (captured != NO_PIECE) remove_piece(pos, to);
+        move_piece(pos, from, to);
 
 		// Halfmove clock reset if pawn move or capture
         if (piece_type(moving) == PAWN || captured != NO_PIECE)
@@ -279,87 +627,85 @@ int make_move(Position *pos, const Move *move) {
 		pos->en_passant_target = NO_SQUARE;
 	}
     pos->side_to_move = c_them;
+    pos->key ^= zobrist_castling[pos->castling_rights & 0x0F];
+    if (ep_in_key(pos)) pos->key ^= zobrist_ep_file[file_of(pos->en_passant_target)];
 
     if (c_them == WHITE) pos->fullmove_number++;
+    undo->captured = captured;
     return 1;
 }
 
-bool is_square_attacked(const Position *pos, Square sq, Color attacker) {
-	// 1) Pawn attacks
-	if (attacker == WHITE) {
-		Square nw_p = sq + NW;
-		Square ne_p = sq + NE;
-		if (in_board_sq(nw_p) && pos->board[nw_p] == WHITE_PAWN) return true;
-		if (in_board_sq(ne_p) && pos->board[ne_p] == WHITE_PAWN) return true;
+// Take back the move saved in 'undo' (the last one made on this position)
+void unmake_move(Position *pos, const Undo *undo) {
+	Move move = undo->move;
+	Square from = move_from(move);
+	Square to   = move_to(move);
+	Color c_us = !pos->side_to_move; // the side that made the move
+
+	pos->side_to_move = c_us;
+	if (c_us == BLACK) pos->fullmove_number--;
+
+	if (move_is_castling(move)) {
+		move_piece(pos, to, from);
+		if (move_flags(move) == FLAG_KING_CASTLE)
+			move_piece(pos, (c_us==WHITE) ? F1 : F8, (c_us==WHITE) ? H1 : H8);
+		else
+			move_piece(pos, (c_us==WHITE) ? D1 : D8, (c_us==WHITE) ? A1 : A8);
+	}
+	else if (move_flags(move) == FLAG_EN_PASSANT) {
+		move_piece(pos, to, from);
+		put_piece(pos, undo->captured, c_us == WHITE ? to + S : to + N);
+	}
+	else if (move_is_promotion(move)) {
+		remove_piece(pos, to);
+		put_piece(pos, make_piece(c_us, PAWN), from);
+		if (undo->captured != NO_PIECE) put_piece(pos, undo->captured, to);
 	}
 	else {
-		Square sw_p = sq + SW;
-		Square se_p = sq + SE;
-		if (in_board_sq(sw_p) && pos->board[sw_p] == BLACK_PAWN) return true;
-		if (in_board_sq(se_p) && pos->board[se_p] == BLACK_PAWN) return true;
+		move_piece(pos, to, from);
+		if (undo->captured != NO_PIECE) put_piece(pos, undo->captured, to);
 	}
+
+	pos->castling_rights = undo->castling_rights;
+	pos->en_passant_target = undo->en_passant_target;
+	pos->halfmove_clock = undo->halfmove_clock;
+	pos->key = undo->key;
+}
+
+// Pieces of both colors attacking sq, with 'occupied' standing in for the board occupancy
+// (slider attacks go through squares missing from it, so x-rays show up once the front
+// piece is taken out). Pieces off 'occupied' are not filtered out.
+Bitboard attackers_to(const Position *pos, Square sq, Bitboard occupied) {
+	const Bitboard *pc = pos->pieces;
+	Bitboard bishops = pc[WHITE_BISHOP] | pc[BLACK_BISHOP] | pc[WHITE_QUEEN] | pc[BLACK_QUEEN];
+	Bitboard rooks = pc[WHITE_ROOK] | pc[BLACK_ROOK] | pc[WHITE_QUEEN] | pc[BLACK_QUEEN];
+	return (pawn_attacks[BLACK][sq] & pc[WHITE_PAWN]) |
+	       (pawn_attacks[WHITE][sq] & pc[BLACK_PAWN]) |
+	       (knight_attacks[sq] & (pc[WHITE_KNIGHT] | pc[BLACK_KNIGHT])) |
+	       (bishop_attacks(sq, occupied) & bishops) |
+	       (rook_attacks(sq, occupied) & rooks) |
+	       (king_attacks[sq] & (pc[WHITE_KING] | pc[BLACK_KING]));
+}
+
+bool is_square_attacked(const Position *pos, Square sq, Color attacker) {
+	const Bitboard *pc = pos->pieces;
+	Piece pawn = make_piece(attacker, PAWN);
+	Piece knight = make_piece(attacker, KNIGHT);
+	Piece bishop = make_piece(attacker, BISHOP);
+	Piece rook = make_piece(attacker, ROOK);
+	Piece queen = make_piece(attacker, QUEEN);
+	Piece king = make_piece(attacker, KING);
+
+	// 1) Pawn attacks: a pawn of ours on sq would attack the attacker's pawns
+	if (pawn_attacks[!attacker][sq] & pc[pawn]) return true;
 	// 2) Knight attacks
-	for (int i = 0; i < 8; i++) {
-		int k_f = file_of(sq) + KN[i][0];
-		int k_r = rank_of(sq) + KN[i][1];
-		Square k_sq = SQ(k_f, k_r);
-		if (in_board_sq(k_sq)) {
-			Piece p = pos->board[k_sq];
-			if ((attacker == WHITE && p == WHITE_KNIGHT) ||
-				(attacker == BLACK && p == BLACK_KNIGHT)) {
-				return true;
-			}
-		}
-	}
+	if (knight_attacks[sq] & pc[knight]) return true;
 	// 3) Bishop/Queen/Rook attacks
-	for (int dir = 0; dir < 8; dir++) {
-		int new_f = file_of(sq);
-		int new_r = rank_of(sq);
-		while (true) {
-			new_f += QDIR[dir][0];
-			new_r += QDIR[dir][1];
-			Square new_sq = SQ(new_f, new_r);
-			if (!in_board_sq(new_sq)) break;
-			Piece p = pos->board[new_sq];
-			if (p != NO_PIECE) {
-				if (piece_color(p) == attacker) {
-					if (piece_type(p) == QUEEN) return true;
-					if ((dir < 4) && piece_type(p) == ROOK) return true; // Rook directions
-					if ((dir >= 4) && piece_type(p) == BISHOP) return true; // Bishop directions
-				}
-				break; // Blocked by any piece
-			}
-		}
-	}
+	if (bishop_attacks(sq, pos->occupied) & (pc[bishop] | pc[queen])) return true;
+	if (rook_attacks(sq, pos->occupied) & (pc[rook] | pc[queen])) return true;
 	// 4) King attacks
-	for (int df = -1; df <= 1; df++) {
-		for (int dr = -1; dr <= 1; dr++) {
-			if (df == 0 && dr == 0) continue;
-			int k_f = file_of(sq) + df;
-			int k_r = rank_of(sq) + dr;
-			Square k_sq = SQ(k_f, k_r);
-			if (in_board_sq(k_sq)) {
-				Piece p = pos->board[k_sq];
-				if ((attacker == WHITE && p == WHITE_KING) ||
-					(attacker == BLACK && p == BLACK_KING)) {
-					return true;
-				}
-			}
-		}
-	}
-	
+	if (king_attacks[sq] & pc[king]) return true;
 
 	return false;
 }
 
-Square find_king(const Position *pos, Color c) {
-	Piece king = (c == WHITE) ? WHITE_KING : BLACK_KING;
-	Square ksq = NO_SQUARE;
-	for (Square sq = 0; sq < NUM_SQUARES; sq++) {
-		if (pos->board[sq] == king) {
-			ksq = sq;
-			break;
-		}
-	}
-	return ksq; // Null return should never happen in a valid position
-}	
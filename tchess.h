@@ -10,7 +10,8 @@
 
 // TYPEDEFS
 typedef int16_t Square;
-#define SQ(file, rank) (Square)((7 - rank) * NUM_RANKS + file)
+#define SQ(file, rank) (Square)((7 - (rank)) * NUM_RANKS + (file))
+typedef uint64_t Bitboard; // bit n set <=> square n occupied (a8 = bit 0, h1 = bit 63)
 
 // Move types
 typedef enum { NORMAL=0, CAPTURE, EN_PASSANT, CASTLING_KINGSIDE, CASTLING_QUEENSIDE, PROMOTION } MoveType;
@@ -36,12 +37,13 @@ enum {
     NO_SQUARE = -1
 };
 
+// Unpacked move, see move_pack/move_unpack for the conversion to Move
 typedef struct {
 	Square from; // 0-63 for squares a1-h8
 	Square to; // 0-63 for squares a1-h8
 	MoveType type;
 	char promotionPiece; // 'q', 'r', 'b', 'n' for promotion moves, '0' otherwise
-} Move;
+} MoveInfo;
 
 typedef enum {
 	WHITE,
@@ -74,20 +76,79 @@ typedef enum {
 	BLACK_QUEEN,
 	BLACK_KING,
 } Piece;
+#define NUM_PIECES (BLACK_KING + 1)
 
-// Chessboard as 1D array of pieces
+// Moves are packed in 16 bits: from square (bits 0-5), to square (bits 6-11), flags (bits 12-15)
+typedef uint16_t Move;
+#define MOVE_NONE ((Move)0) // a8a8, never a real move
+
+// Move flags: bit 2 marks captures, bit 3 promotions (the low two bits then give the piece)
+enum {
+	FLAG_QUIET = 0,
+	FLAG_DOUBLE_PUSH = 1,
+	FLAG_KING_CASTLE = 2,
+	FLAG_QUEEN_CASTLE = 3,
+	FLAG_CAPTURE = 4,
+	FLAG_EN_PASSANT = 5,
+	FLAG_PROMOTION = 8,          // + 0..3 for knight, bishop, rook, queen
+	FLAG_PROMOTION_CAPTURE = 12  // + 0..3 as well
+};
+
+static inline Move new_move(Square from, Square to, int flags) {
+	return (Move)(from | (to << 6) | (flags << 12));
+}
+static inline Square move_from(Move m) { return (Square)(m & 0x3F); }
+static inline Square move_to(Move m) { return (Square)((m >> 6) & 0x3F); }
+static inline int move_flags(Move m) { return m >> 12; }
+static inline bool move_is_capture(Move m) { return (m >> 12) & FLAG_CAPTURE; }
+static inline bool move_is_promotion(Move m) { return (m >> 12) & FLAG_PROMOTION; }
+static inline bool move_is_castling(Move m) { return move_flags(m) == FLAG_KING_CASTLE || move_flags(m) == FLAG_QUEEN_CASTLE; }
+static inline PieceType move_promotion_type(Move m) { return (PieceType)(KNIGHT + ((m >> 12) & 3)); }
+
+// Chessboard as 1D array of pieces, mirrored by bitboards
 typedef struct {
     Piece board[NUM_SQUARES];
+	Bitboard pieces[NUM_PIECES]; // one set per piece, indexed by Piece (NO_PIECE unused)
+	Bitboard colors[2];          // all pieces of each color
+	Bitboard occupied;           // colors[WHITE] | colors[BLACK]
     Color side_to_move;
 	int8_t castling_rights; // bitmask: 0bKQkq (1 for available, 0 for unavailable)
     Square en_passant_target;   // NO_SQUARE if none
     int    halfmove_clock;
     int    fullmove_number;
+	uint64_t key;               // Zobrist key, kept up to date by make_move
+	uint64_t pawn_key;          // Zobrist key of the pawns alone
+	int score_mg, score_eg;     // material + piece-square sums (white's view), see eval.h
+	int phase;                  // non-pawn material left, PHASE_MAX at the start
+	Square king_sq[2];          // by color, NO_SQUARE if there is no king (the other pieces are found
+	                            // through their bitboards)
 } Position;
 
+// What make_move_undo saves so that unmake_move can restore the position without a copy
+typedef struct {
+	Move move;
+	Piece captured;            // NO_PIECE if the move was not a capture
+	int8_t castling_rights;
+	Square en_passant_target;
+	int halfmove_clock;
+	uint64_t key;
+} Undo;
+
+// Undo records of the line currently played on a position (one per thread walking a tree)
+#define MAX_PLY 256
+typedef struct {
+	Undo undo[MAX_PLY];
+	int ply;
+} UndoStack;
+
 // Auxiliary functions
 char piece_to_char(Piece piece);
-char* square_to_string(Square square);
+char* square_name(Square square, char buffer[3]); // Writes e.g. "e4" into buffer, returns it
+char* square_to_string(Square square); // Same, heap-allocated (caller frees)
+int move_to_uci(Move move, char buffer[6]); // Writes e.g. "e7e8q" into buffer, returns its length
+bool move_from_uci(const char *move_str, MoveInfo *move); // Parse "e2e4"/"e7e8q", without a position
+Move move_pack(MoveInfo info);  // Conversions between the packed and the unpacked move; packing
+MoveInfo move_unpack(Move move); // can't tell captures or double pushes without the position
 
 // Get color
 static inline Color piece_color(Piece piece) {
@@ -114,6 +175,8 @@ static inline bool in_board(int f, int r){ return (f >= 0 ) && (f < NUM_FILES) &
 static inline bool in_board_sq(Square sq){ return (file_of(sq) >= 0 ) && (file_of(sq) < NUM_FILES) && (rank_of(sq) >= 0) && (rank_of(sq) < NUM_RANKS); } // true if on board
 static inline Square sq_of(int f,int r){ return (Square)(r*NUM_FILES + f); }
 static inline Piece at(const Position* pos, Square s){ return pos->board[s]; }
+static inline Bitboard sq_bb(Square s){ return 1ULL << s; }
+static inline Piece make_piece(Color c, PieceType t){ return (Piece)(t + (c == BLACK ? 6 : 0)); }
 
 static inline Piece promo_to_piece(Color us, char promoChar){
     if (us == WHITE){
@@ -125,7 +188,7 @@ static inline Piece promo_to_piece(Color us, char promoChar){
     }
 }
 
-// Move list
+// Move list (218 is the most legal moves any position has)
 typedef struct { Move list[256]; int count; } MoveList;
 
 static inline void add_move(MoveList* ml, Move m){
@@ -136,14 +199,35 @@ static inline void add_move(MoveList* ml, Move m){
 
 // FUNCTION PROTOTYPES
 void init_position(Position *pos); // Initialize the position to the starting position
-bool parse_fen(const char *fen, Position *pos); // TODO
-char* position_to_fen(const Position *pos); // TODO
+void update_bitboards(Position *pos); // Rebuild the bitboards, pawn key and evaluation sums from the board array
+void init_zobrist(void); // Fill the Zobrist tables, once before any position is set up
+uint64_t compute_key(const Position *pos); // Zobrist key computed from scratch
+bool parse_fen(const char *fen, Position *pos); // Load a position from a FEN string
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+bool parse_fen_args(int argc, char **argv, Position *pos); // FEN from command line arguments (none: START_FEN); false after a message
+#define FEN_MAX 128
+char* position_to_fen(const Position *pos, char *buffer); // Write the FEN (at most FEN_MAX chars) into buffer
 void print_board(const Position *pos); // Print the board with pieces
 
-Move* parse_move(const char *move_str); // Parse a move from a string
-int make_move(Position *pos, const Move *move); // Make a move on the board
+MoveInfo* parse_move(const char *move_str); // Parse a move from a string (heap-allocated, caller frees)
+Move uci_to_move(const Position *pos, const char *move_str); // Parse a UCI move with its flags, MOVE_NONE if malformed
+int make_move(Position *pos, Move move); // Make a move on the board
+int make_move_undo(Position *pos, Move move, Undo *undo); // Make a move, saving what's needed to take it back
+void unmake_move(Position *pos, const Undo *undo); // Take back the last move made with make_move_undo
 
 bool is_square_attacked(const Position *pos, Square square, Color attacker);
-Square find_king(const Position *pos, Color color);
+Bitboard attackers_to(const Position *pos, Square square, Bitboard occupied); // Attackers of both colors
+static inline Square find_king(const Position *pos, Color color) { return pos->king_sq[color]; } // O(1), NO_SQUARE if none
+
+// Play and take back moves on an undo stack
+static inline int push_move(Position *pos, UndoStack *st, Move move) {
+	if (st->ply >= MAX_PLY || !make_move_undo(pos, move, &st->undo[st->ply])) return 0;
+	st->ply++;
+	return 1;
+}
+
+static inline void pop_move(Position *pos, UndoStack *st) {
+	unmake_move(pos, &st->undo[--st->ply]);
+}
 
 #endif // TCHESS_H
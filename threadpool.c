@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L // sysconf
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#define MAX_WORKERS 256
+
+// The range of task indices still owned by one worker
+typedef struct {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t end;
+} Slice;
+
+typedef struct {
+	Slice slices[MAX_WORKERS];
+	int num_workers;
+	PoolTaskFn fn;
+	void *ctx;
+} Pool;
+
+typedef struct {
+	Pool *pool;
+	int id;
+} Worker;
+
+// Take the next task from the front of our own slice
+static bool take_own(Slice *s, size_t *index) {
+	bool found = false;
+	pthread_mutex_lock(&s->lock);
+	if (s->next < s->end) {
+		*index = s->next++;
+		found = true;
+	}
+	pthread_mutex_unlock(&s->lock);
+	return found;
+}
+
+// Move the back half of a victim's slice into our own (empty) slice
+static bool steal(Pool *pool, int thief) {
+	Slice *own = &pool->slices[thief];
+	for (int i = 1; i < pool->num_workers; i++) {
+		Slice *victim = &pool->slices[(thief + i) % pool->num_workers];
+		pthread_mutex_lock(&victim->lock);
+		size_t left = victim->end - victim->next;
+		if (left == 0) {
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		size_t begin = victim->end - (left + 1) / 2;
+		size_t end = victim->end;
+		victim->end = begin;
+		pthread_mutex_unlock(&victim->lock);
+
+		pthread_mutex_lock(&own->lock);
+		own->next = begin;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+		return true;
+	}
+	return false;
+}
+
+static void *worker_main(void *arg) {
+	Worker *w = arg;
+	Pool *pool = w->pool;
+	size_t index;
+	do {
+		while (take_own(&pool->slices[w->id], &index)) {
+			pool->fn(pool->ctx, index, w->id);
+		}
+	} while (steal(pool, w->id));
+	return NULL;
+}
+
+void pool_run(int num_threads, size_t count, PoolTaskFn fn, void *ctx) {
+	Pool pool;
+	if (num_threads < 1) num_threads = 1;
+	if (num_threads > MAX_WORKERS) num_threads = MAX_WORKERS;
+	if ((size_t)num_threads > count) num_threads = count ? (int)count : 1;
+	pool.num_workers = num_threads;
+	pool.fn = fn;
+	pool.ctx = ctx;
+
+	for (int i = 0; i < num_threads; i++) {
+		pthread_mutex_init(&pool.slices[i].lock, NULL);
+		pool.slices[i].next = count * i / num_threads;
+		pool.slices[i].end = count * (i + 1) / num_threads;
+	}
+
+	Worker workers[MAX_WORKERS];
+	pthread_t threads[MAX_WORKERS];
+	for (int i = 0; i < num_threads; i++) {
+		workers[i] = (Worker){&pool, i};
+	}
+	// Worker 0 is the calling thread; fall back to running alone if a thread can't be started
+	int started = 1;
+	for (int i = 1; i < num_threads; i++, started++) {
+		if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) break;
+	}
+	worker_main(&workers[0]);
+	for (int i = 1; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	// Slices of workers that never started still hold tasks
+	for (int i = started; i < num_threads; i++) {
+		size_t index;
+		while (take_own(&pool.slices[i], &index)) fn(ctx, index, 0);
+	}
+
+	for (int i = 0; i < num_threads; i++) {
+		pthread_mutex_destroy(&pool.slices[i].lock);
+	}
+}
+
+int pool_default_threads(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+}
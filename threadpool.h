@@ -0,0 +1,17 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+// A batch of independent tasks, numbered 0..count-1, run by a group of worker threads.
+// Each worker starts with an equal slice of the indices and, once its slice is empty,
+// steals half of what is left in another worker's slice.
+typedef void (*PoolTaskFn)(void *ctx, size_t index, int worker);
+
+// Run fn(ctx, i, worker) for every i in [0, count) on num_threads threads (the caller's
+// thread being worker 0), and return once all of them are done
+void pool_run(int num_threads, size_t count, PoolTaskFn fn, void *ctx);
+
+int pool_default_threads(void); // Number of online CPUs (at least 1)
+
+#endif // THREADPOOL_H
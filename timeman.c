@@ -0,0 +1,46 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#include "timeman.h"
+#include <time.h>
+
+double tm_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void tm_init(TimeManager *tm, int movetime_ms, int time_ms, int inc_ms, int movestogo) {
+	tm->start = tm_now();
+	tm->soft = tm->hard = 0;
+	if (movetime_ms > 0) {
+		// Keep the overhead in hand as on a clock, but never search less than half the time
+		int ms = movetime_ms > 2 * MOVE_OVERHEAD_MS ? movetime_ms - MOVE_OVERHEAD_MS : movetime_ms / 2;
+		tm->hard = (ms > 0 ? ms : 1) / 1000.0;
+		return;
+	}
+	if (time_ms <= 0) return;
+
+	// An even share of what is left, plus most of the increment, never more than a quarter
+	// of the clock for the soft limit and three quarters of it for the hard one
+	double available = (time_ms > 2 * MOVE_OVERHEAD_MS ? time_ms - MOVE_OVERHEAD_MS : time_ms / 2) / 1000.0;
+	int moves = movestogo > 0 ? (movestogo < 40 ? movestogo : 40) : 30;
+	double share = available / moves + 0.75 * inc_ms / 1000.0;
+	tm->hard = share * 4 < available * 0.75 ? share * 4 : available * 0.75;
+	tm->soft = share < tm->hard ? share : tm->hard;
+	if (moves == 1) tm->soft = tm->hard; // last move before the control: use what there is
+}
+
+double tm_elapsed(const TimeManager *tm) {
+	return tm_now() - tm->start;
+}
+
+bool tm_hard_expired(const TimeManager *tm) {
+	return tm->hard > 0 && tm_elapsed(tm) >= tm->hard;
+}
+
+bool tm_soft_expired(const TimeManager *tm, int stability) {
+	if (tm->soft <= 0) return false;
+	// A best move that just changed gets more time, one that has held for a while less
+	static const double scale[] = { 1.6, 1.2, 1.0, 0.85, 0.7 };
+	double limit = tm->soft * scale[stability < 4 ? stability : 4];
+	return tm_elapsed(tm) >= (limit < tm->hard ? limit : tm->hard);
+}
@@ -0,0 +1,27 @@
+#ifndef TIMEMAN_H
+#define TIMEMAN_H
+
+#include <stdbool.h>
+
+// Time allotted to one search, on the monotonic clock. The hard limit aborts the search in the
+// middle of an iteration; the soft limit only keeps a new iteration from starting, and is
+// stretched while the best move keeps changing and shrunk once it has settled.
+typedef struct {
+	double start; // seconds
+	double soft;  // seconds after start, 0 if none (fixed move time: the whole time is used)
+	double hard;  // 0 if there is no time limit
+} TimeManager;
+
+#define MOVE_OVERHEAD_MS 20 // kept in hand for the engine/GUI round trip
+
+double tm_now(void);
+
+// movetime_ms: fixed time for this move; otherwise time_ms/inc_ms are the mover's clock and
+// increment and movestogo the moves to the next time control (0: the rest of the game)
+void tm_init(TimeManager *tm, int movetime_ms, int time_ms, int inc_ms, int movestogo);
+double tm_elapsed(const TimeManager *tm);
+bool tm_hard_expired(const TimeManager *tm);
+// stability: completed iterations in a row that kept the same best move
+bool tm_soft_expired(const TimeManager *tm, int stability);
+
+#endif // TIMEMAN_H
@@ -0,0 +1,93 @@
+#include "tt.h"
+#include <stdlib.h>
+
+#define AGE_MASK 0x3F
+
+_Static_assert(sizeof(TTBucket) == 64, "a bucket must fill one cache line");
+
+bool tt_init(TransTable *tt, size_t mb) {
+	tt->buckets = hash_alloc(mb, sizeof(TTBucket), &tt->mask);
+	tt->generation = 0;
+	return tt->buckets != NULL;
+}
+
+void tt_free(TransTable *tt) {
+	free(tt->buckets);
+	tt->buckets = NULL;
+	tt->mask = 0;
+}
+
+void tt_clear(TransTable *tt) {
+	for (uint64_t i = 0; i <= tt->mask; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE; j++) {
+			hash_entry_write(&tt->buckets[i].entries[j], 0, 0);
+		}
+	}
+	tt->generation = 0;
+}
+
+void tt_new_search(TransTable *tt) {
+	tt->generation = (tt->generation + 1) & AGE_MASK;
+}
+
+static inline uint64_t pack(Move move, int score, int depth, int bound, int age) {
+	return (uint64_t)move | (uint64_t)(uint16_t)(int16_t)score << 16 | (uint64_t)(uint8_t)depth << 32 |
+	       (uint64_t)bound << 40 | (uint64_t)age << 42;
+}
+
+static inline int data_depth(uint64_t data) { return (int)(data >> 32 & 0xFF); }
+static inline int data_bound(uint64_t data) { return (int)(data >> 40 & 3); }
+static inline int data_age(uint64_t data) { return (int)(data >> 42 & AGE_MASK); }
+
+bool tt_probe(const TransTable *tt, uint64_t key, TTHit *hit) {
+	TTBucket *b = &tt->buckets[key & tt->mask];
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		uint64_t data;
+		if (!hash_entry_read(&b->entries[i], key, &data) || data_bound(data) == BOUND_NONE) continue;
+		hit->move = (Move)(data & 0xFFFF);
+		hit->score = (int16_t)(data >> 16 & 0xFFFF);
+		hit->depth = data_depth(data);
+		hit->bound = data_bound(data);
+		return true;
+	}
+	return false;
+}
+
+// Same position: overwrite it. Otherwise replace the entry that is worth least: shallow
+// entries and entries left over from earlier searches go first.
+void tt_store(TransTable *tt, uint64_t key, Move move, int score, int depth, int bound) {
+	TTBucket *b = &tt->buckets[key & tt->mask];
+	HashEntry *victim = NULL;
+	int worst = 1 << 30;
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		HashEntry *e = &b->entries[i];
+		uint64_t data;
+		if (hash_entry_read(e, key, &data)) {
+			// Keep a deeper result for this search, and the old move if we have none
+			if (bound != BOUND_EXACT && data_age(data) == tt->generation && data_depth(data) > depth + 2) return;
+			if (move == MOVE_NONE) move = (Move)(data & 0xFFFF);
+			victim = e;
+			break;
+		}
+		int age = (tt->generation - data_age(data)) & AGE_MASK;
+		int worth = data_depth(data) - 8 * age;
+		if (worth < worst) {
+			worst = worth;
+			victim = e;
+		}
+	}
+	uint64_t data = pack(move, score, depth < 0 ? 0 : depth, bound, tt->generation);
+	hash_entry_write(victim, key, data);
+}
+
+int tt_hashfull(const TransTable *tt) {
+	int used = 0;
+	int sampled = 0;
+	for (uint64_t i = 0; i <= tt->mask && sampled < 1000; i++) {
+		for (int j = 0; j < TT_BUCKET_SIZE && sampled < 1000; j++, sampled++) {
+			uint64_t data = atomic_load_explicit(&tt->buckets[i].entries[j].data, memory_order_relaxed);
+			if (data_bound(data) != BOUND_NONE && data_age(data) == tt->generation) used++;
+		}
+	}
+	return sampled ? used * 1000 / sampled : 0;
+}
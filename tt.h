@@ -0,0 +1,40 @@
+#ifndef TT_H
+#define TT_H
+
+#include "tchess.h"
+#include "hashtable.h"
+#include <stddef.h>
+
+// Transposition table shared by the search threads, keyed by the Zobrist key.
+// Entry data: move (bits 0-15), score (16-31), depth (32-39), bound (40-41), age (42-47).
+#define TT_BUCKET_SIZE 4 // 64-byte buckets, one cache line each
+typedef struct {
+	HashEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+typedef struct {
+	TTBucket *buckets;
+	uint64_t mask;      // number of buckets - 1 (a power of two)
+	uint8_t generation; // age of the current search, 6 bits
+} TransTable;
+
+// Bounds: the score is an upper bound (fail low), a lower bound (fail high) or exact
+enum { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+typedef struct {
+	Move move;
+	int score;
+	int depth;
+	int bound;
+} TTHit;
+
+bool tt_init(TransTable *tt, size_t mb); // Allocate about mb megabytes; false if out of memory
+void tt_free(TransTable *tt);
+void tt_clear(TransTable *tt);
+void tt_new_search(TransTable *tt);      // Age the entries of the previous searches
+
+bool tt_probe(const TransTable *tt, uint64_t key, TTHit *hit);
+void tt_store(TransTable *tt, uint64_t key, Move move, int score, int depth, int bound);
+int tt_hashfull(const TransTable *tt);   // Permille of entries written by the current search
+
+#endif // TT_H
@@ -0,0 +1,265 @@
+#define _POSIX_C_SOURCE 200809L // getline, strdup, nanosleep
+#include "uci.h"
+#include "tchess.h"
+#include "generators.h"
+#include "rules.h"
+#include "search.h"
+#include "tt.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_HASH_MB 16
+#define MAX_HASH_MB 65536
+#define MAX_THREADS 256 // as many workers as the thread pool takes
+
+typedef struct {
+	Position pos;
+	GameHistory history;      // the game up to pos, for repetition draws
+	char *position_line;      // last "position" command applied (NULL if none or it failed)
+	TransTable tt;
+	int hash_mb;
+	int threads;
+	SearchLimits limits;
+	atomic_bool stop;
+	atomic_bool ponder;
+	pthread_t search_thread;
+	bool searching;           // search_thread is running or not joined yet
+} Uci;
+
+static void respond(const char *line) {
+	printf("%s\n", line);
+	fflush(stdout);
+}
+
+static void *search_main(void *ctx) {
+	Uci *u = ctx;
+	SearchResult result;
+	search(&u->pos, &u->history, &u->tt, &u->limits, u->threads, &result);
+
+	// Even if there is nothing more to search, the GUI expects no bestmove before it says
+	// stop (infinite search) or ponderhit (pondering)
+	struct timespec pause = { 0, 1000000 };
+	while ((u->limits.infinite || atomic_load(&u->ponder)) && !atomic_load(&u->stop)) nanosleep(&pause, NULL);
+
+	char best[6] = "0000";
+	char ponder[6];
+	if (result.best_move != MOVE_NONE) move_to_uci(result.best_move, best);
+	if (result.pv_length > 1) {
+		move_to_uci(result.pv[1], ponder);
+		printf("bestmove %s ponder %s\n", best, ponder);
+	} else {
+		printf("bestmove %s\n", best);
+	}
+	fflush(stdout);
+	return NULL;
+}
+
+// Stop the search if one is running and wait for its bestmove
+static void finish_search(Uci *u) {
+	if (!u->searching) return;
+	atomic_store(&u->stop, true);
+	atomic_store(&u->ponder, false);
+	pthread_join(u->search_thread, NULL);
+	u->searching = false;
+}
+
+// Play the moves of a "moves" list; false at the first illegal one
+static bool play_moves(Uci *u, char *moves) {
+	char *saveptr;
+	for (char *tok = strtok_r(moves, " \t", &saveptr); tok; tok = strtok_r(NULL, " \t", &saveptr)) {
+		if (strcmp(tok, "moves") == 0) continue;
+		Move move = uci_to_move(&u->pos, tok);
+		if (move == MOVE_NONE || !is_pseudo_legal(&u->pos, move) || !is_legal(&u->pos, move)) {
+			printf("info string illegal move %s\n", tok);
+			fflush(stdout);
+			return false;
+		}
+		make_move(&u->pos, move);
+		history_push(&u->history, &u->pos);
+	}
+	return true;
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+// GUIs resend the whole game before every move, so when the command extends the previous one
+// only the moves that were not played yet are parsed and made.
+static void cmd_position(Uci *u, const char *line) {
+	char *copy = strdup(line);
+	if (!copy) return;
+	size_t len = u->position_line ? strlen(u->position_line) : 0;
+	char *rest;
+	if (u->position_line && strncmp(line, u->position_line, len) == 0 && (line[len] == ' ' || line[len] == '\0')) {
+		rest = copy + len;
+	} else {
+		char *fen = strstr(copy, " fen ");
+		char *moves = strstr(copy, " moves");
+		rest = moves ? moves : copy + strlen(copy);
+		if (fen && (!moves || fen < moves)) {
+			fen += strlen(" fen ");
+			char saved = *rest;
+			*rest = '\0';
+			bool ok = parse_fen(fen, &u->pos);
+			if (!ok) {
+				// Play nothing on a position the GUI never sent, and parse the next command afresh
+				printf("info string invalid fen %s, moves ignored\n", fen);
+				fflush(stdout);
+				init_position(&u->pos);
+				history_free(&u->history);
+				history_init(&u->history, &u->pos);
+				free(u->position_line);
+				u->position_line = NULL;
+				free(copy);
+				return;
+			}
+			*rest = saved;
+		} else {
+			init_position(&u->pos);
+		}
+		history_free(&u->history);
+		history_init(&u->history, &u->pos);
+	}
+
+	bool ok = play_moves(u, rest);
+	free(u->position_line);
+	u->position_line = NULL;
+	if (ok) u->position_line = strdup(line);
+	free(copy);
+}
+
+// go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [depth <n>] [nodes <n>]
+//    [movetime <ms>] [infinite] [ponder]
+static void cmd_go(Uci *u, char *args) {
+	SearchLimits *l = &u->limits;
+	memset(l, 0, sizeof(*l));
+	bool ponder = false;
+	char *saveptr;
+	for (char *tok = strtok_r(args, " \t", &saveptr); tok; tok = strtok_r(NULL, " \t", &saveptr)) {
+		if (strcmp(tok, "infinite") == 0) { l->infinite = true; continue; }
+		if (strcmp(tok, "ponder") == 0) { ponder = true; continue; }
+		char *value = strtok_r(NULL, " \t", &saveptr);
+		if (!value) break;
+		if (strcmp(tok, "wtime") == 0) l->time_ms[WHITE] = atoi(value);
+		else if (strcmp(tok, "btime") == 0) l->time_ms[BLACK] = atoi(value);
+		else if (strcmp(tok, "winc") == 0) l->inc_ms[WHITE] = atoi(value);
+		else if (strcmp(tok, "binc") == 0) l->inc_ms[BLACK] = atoi(value);
+		else if (strcmp(tok, "movestogo") == 0) l->movestogo = atoi(value);
+		else if (strcmp(tok, "depth") == 0) l->depth = atoi(value);
+		else if (strcmp(tok, "nodes") == 0) l->nodes = strtoull(value, NULL, 10);
+		else if (strcmp(tok, "movetime") == 0) l->movetime_ms = atoi(value);
+	}
+	// A bare "go" searches until stopped
+	Color us = u->pos.side_to_move;
+	if (!l->depth && !l->nodes && !l->movetime_ms && !l->time_ms[us]) l->infinite = true;
+	l->stop = &u->stop;
+	l->ponder = &u->ponder;
+	atomic_store(&u->stop, false);
+	atomic_store(&u->ponder, ponder);
+	u->searching = pthread_create(&u->search_thread, NULL, search_main, u) == 0;
+	if (!u->searching) respond("bestmove 0000");
+}
+
+// setoption name <name> [value <value>]
+static void cmd_setoption(Uci *u, char *args) {
+	char *name = strstr(args, "name ");
+	if (!name) return;
+	name += strlen("name ");
+	char *value = strstr(name, " value ");
+	if (value) {
+		*value = '\0';
+		value += strlen(" value ");
+	}
+	if (strcmp(name, "Hash") == 0 && value) {
+		int mb = atoi(value);
+		if (mb < 1 || mb > MAX_HASH_MB) return;
+		tt_free(&u->tt);
+		if (tt_init(&u->tt, (size_t)mb)) {
+			u->hash_mb = mb;
+		} else {
+			respond("info string cannot allocate the hash, keeping the default size");
+			u->hash_mb = DEFAULT_HASH_MB;
+			tt_init(&u->tt, DEFAULT_HASH_MB);
+		}
+	} else if (strcmp(name, "Threads") == 0 && value) {
+		int threads = atoi(value);
+		if (threads >= 1 && threads <= MAX_THREADS) u->threads = threads;
+	} else if (strcmp(name, "Clear Hash") == 0) {
+		tt_clear(&u->tt);
+	}
+}
+
+static void identify(void) {
+	printf("id name tchess\n");
+	printf("option name Hash type spin default %d min 1 max %d\n", DEFAULT_HASH_MB, MAX_HASH_MB);
+	printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+	printf("option name Clear Hash type button\n");
+	printf("option name Ponder type check default false\n");
+	respond("uciok");
+}
+
+// Whether line is the command cmd, with or without arguments
+static bool is_command(const char *line, const char *cmd) {
+	size_t n = strlen(cmd);
+	return strncmp(line, cmd, n) == 0 && (line[n] == ' ' || line[n] == '\0');
+}
+
+int uci_loop(bool greeted) {
+	Uci *u = calloc(1, sizeof(Uci));
+	if (!u) return EXIT_FAILURE;
+	u->hash_mb = DEFAULT_HASH_MB;
+	u->threads = 1;
+	if (!tt_init(&u->tt, u->hash_mb)) {
+		free(u);
+		return EXIT_FAILURE;
+	}
+	init_position(&u->pos);
+	history_init(&u->history, &u->pos);
+	atomic_init(&u->stop, false);
+	atomic_init(&u->ponder, false);
+	if (greeted) identify();
+
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	while ((length = getline(&line, &capacity, stdin)) != -1) {
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+		char *args = strchr(line, ' ');
+		args = args ? args + 1 : line + length;
+
+		// Commands that can arrive while searching come first: they must not wait for it
+		if (is_command(line, "isready")) {
+			respond("readyok");
+		} else if (is_command(line, "stop")) {
+			atomic_store(&u->stop, true);
+		} else if (is_command(line, "ponderhit")) {
+			atomic_store(&u->ponder, false); // the time management takes over from here
+		} else if (is_command(line, "quit")) {
+			break;
+		} else if (is_command(line, "uci")) {
+			identify();
+		} else if (is_command(line, "ucinewgame")) {
+			finish_search(u);
+			tt_clear(&u->tt);
+		} else if (is_command(line, "position")) {
+			finish_search(u);
+			cmd_position(u, line);
+		} else if (is_command(line, "go")) {
+			finish_search(u);
+			cmd_go(u, args);
+		} else if (is_command(line, "setoption")) {
+			finish_search(u);
+			cmd_setoption(u, args);
+		}
+	}
+
+	finish_search(u);
+	free(line);
+	free(u->position_line);
+	history_free(&u->history);
+	tt_free(&u->tt);
+	free(u);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+#ifndef UCI_H
+#define UCI_H
+
+#include <stdbool.h>
+
+// Universal Chess Interface: commands are read from stdin while the search runs on a thread
+// of its own, so "stop", "ponderhit" and "isready" are answered at once. Returns on "quit"
+// or at the end of the input. greeted: the "uci" command has already been read.
+int uci_loop(bool greeted);
+
+#endif // UCI_H